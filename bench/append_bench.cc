@@ -0,0 +1,93 @@
+#include "btree.h"
+#include "bfs.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using Tree = BTree::Tree<int, int>;
+using Node = BTree::Node<int, int>;
+
+struct Footprint {
+    std::size_t nodes = 0;
+    std::size_t items = 0;
+};
+
+Footprint Measure(Tree& t) {
+    Footprint footprint;
+    BFS::Traverse(t.root(), [&footprint](Node* node) {
+        footprint.nodes++;
+        footprint.items += node->items().size();
+    });
+    return footprint;
+}
+
+void Report(const std::string& name, Tree& t, double seconds, int n) {
+    Footprint footprint = Measure(t);
+    std::size_t bytes = footprint.nodes * sizeof(Node) +
+        footprint.items * sizeof(BTree::Item<int, int>);
+    std::printf("%-22s %8.1f ns/insert %9zu nodes %5.2f items/node %8.1f MiB\n",
+                name.c_str(), seconds * 1e9 / n, footprint.nodes,
+                double(footprint.items) / footprint.nodes,
+                bytes / (1024.0 * 1024.0));
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 2000000;
+
+    // Sequential keys descending from the root every time, which is what
+    // Tree::Insert did before the append fast path.
+    {
+        Tree t;
+        t.Insert(0, 0);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 1; i < n; i++) {
+            t.root()->Insert(i, i, true);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Report("root descent", t, elapsed.count(), n);
+    }
+
+    {
+        Tree t;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            t.Insert(i, i);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Report("append fast path", t, elapsed.count(), n);
+    }
+
+    {
+        Tree t;
+        t.EnableOrderStatistics();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            t.Insert(i, i);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Report("append with counts", t, elapsed.count(), n);
+    }
+
+    // Increasing keys that now and then step back a little, like late
+    // timestamps. Finger search should be no slower than Insert here.
+    auto late = [](int i) { return i * 4 - (i % 7) * 5; };
+    {
+        Tree t;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            t.Insert(late(i), i);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Report("late keys, Insert", t, elapsed.count(), n);
+    }
+
+    {
+        Tree t;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            t.InsertNear(late(i), i);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        Report("late keys, InsertNear", t, elapsed.count(), n);
+    }
+}
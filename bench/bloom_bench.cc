@@ -0,0 +1,47 @@
+#include "btree.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+template<typename F>
+void Run(const std::string& name, const std::vector<int>& queries, F find) {
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : queries) {
+        found += find(key);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-14s %8.1f ns/lookup (%ld found)\n", name.c_str(),
+                elapsed.count() * 1e9 / queries.size(), found);
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    int lookups = argc > 2 ? std::stoi(argv[2]) : 4000000;
+    // Percentage of lookups for keys that are not in the tree.
+    int miss_percent = argc > 3 ? std::stoi(argv[3]) : 90;
+    std::mt19937 rng(42);
+
+    BTree::Tree<int, int> plain;
+    BTree::Tree<int, int> filtered;
+    for (int i = 0; i < n; i++) {
+        int key = 2 * (rng() % (4 * n));
+        plain.Insert(key, i);
+        filtered.Insert(key, i);
+    }
+    filtered.EnableBloomFilter();
+    std::vector<int> queries;
+    for (int i = 0; i < lookups; i++) {
+        int key = 2 * (rng() % (4 * n));
+        queries.push_back(static_cast<int>(rng() % 100) < miss_percent ? key + 1 : key);
+    }
+
+    std::printf("%d keys, %d%% misses, filter of %zu KiB\n", n, miss_percent,
+                filtered.bloom_filter()->bytes() / 1024);
+    Run("Find", queries, [&plain](int key) { return plain.Find(key) != nullptr; });
+    Run("Find + bloom", queries, [&filtered](int key) { return filtered.Find(key) != nullptr; });
+    std::printf("false positive rate %.4f\n",
+                filtered.bloom_filter()->stats().FalsePositiveRate());
+}
@@ -0,0 +1,71 @@
+#include "btree.h"
+#include "buffered_tree.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// A burst of random inserts into a tree that is already much larger than
+// the cache, straight into a Tree and through a BufferedTree, then random
+// lookups in both while part of the burst is still buffered.
+
+template<typename F>
+void Run(const std::string& name, std::size_t count, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-22s %8.1f ns/op\n", name.c_str(), elapsed.count() * 1e9 / count);
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 2000000;
+    int burst = argc > 2 ? std::stoi(argv[2]) : 2000000;
+    std::size_t buffer = argc > 3 ? std::stoul(argv[3]) : 4096;
+    std::size_t run = argc > 4 ? std::stoul(argv[4]) : 1 << 18;
+    std::mt19937 rng(42);
+
+    BTree::Tree<int, int> plain;
+    BTree::BufferedTree<int, int> buffered(buffer, run);
+    for (int i = 0; i < n; i++) {
+        int key = rng();
+        plain.Insert(key, i);
+        buffered.Put(key, i);
+    }
+    buffered.Merge();
+    std::vector<int> keys;
+    for (int i = 0; i < burst; i++) {
+        keys.push_back(rng());
+    }
+    std::vector<int> queries;
+    for (int i = 0; i < burst; i++) {
+        queries.push_back(keys[rng() % keys.size()]);
+    }
+
+    std::printf("%d keys, burst of %d inserts, buffer of %zu, runs of %zu\n", n, burst,
+                buffer, run);
+    Run("Tree::Insert", keys.size(), [&]() {
+        for (auto key : keys) {
+            plain.Insert(key, key);
+        }
+    });
+    Run("BufferedTree::Put", keys.size(), [&]() {
+        for (auto key : keys) {
+            buffered.Put(key, key);
+        }
+    });
+    long found = 0;
+    Run("Tree::Find", queries.size(), [&]() {
+        for (auto key : queries) {
+            found += plain.Find(key) != nullptr;
+        }
+    });
+    Run("BufferedTree::Find", queries.size(), [&]() {
+        int value;
+        for (auto key : queries) {
+            found += buffered.Find(key, &value);
+        }
+    });
+    Run("BufferedTree::Merge", buffered.buffered(), [&]() { buffered.Merge(); });
+    std::printf("%ld found, %zu merges\n", found, buffered.merges());
+}
@@ -0,0 +1,42 @@
+#include "btree.h"
+#include "frozen.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+template<typename F>
+void Run(const std::string& name, const std::vector<int>& queries, F find) {
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : queries) {
+        found += find(key);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-14s %8.1f ns/lookup (%ld found)\n", name.c_str(),
+                elapsed.count() * 1e9 / queries.size(), found);
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 4000000;
+    int lookups = argc > 2 ? std::stoi(argv[2]) : 4000000;
+    std::mt19937 rng(42);
+
+    BTree::Tree<int, int> t;
+    for (int i = 0; i < n; i++) {
+        t.Insert(rng() % (4 * n), i);
+    }
+    std::vector<int> queries;
+    for (int i = 0; i < lookups; i++) {
+        queries.push_back(rng() % (4 * n));
+    }
+
+    auto build_start = std::chrono::steady_clock::now();
+    auto frozen = t.Freeze();
+    std::chrono::duration<double> build = std::chrono::steady_clock::now() - build_start;
+    std::printf("%d keys, freeze took %.1f ms\n", n, build.count() * 1e3);
+
+    Run("Tree::Find", queries, [&t](int key) { return t.Find(key) != nullptr; });
+    Run("Frozen::Find", queries, [&frozen](int key) { return frozen.Find(key) != nullptr; });
+}
@@ -0,0 +1,85 @@
+#include "file_system.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// fio-like sequential and random 4 KiB patterns against the file system and
+// against the same calls on a plain file. Both go through the kernel page
+// cache, the difference is what the engine adds or saves on top of it.
+
+const std::size_t kBlock = 4096;
+
+template<typename F>
+void Run(const std::string& name, std::size_t ops, F op) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < ops; i++) {
+        op(i);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-18s %8.0f MiB/s %8.2f us/op\n", name.c_str(),
+                ops * kBlock / elapsed.count() / (1 << 20), elapsed.count() * 1e6 / ops);
+}
+
+int main(int argc, char** argv) {
+    std::size_t mib = argc > 1 ? std::stoul(argv[1]) : 256;
+    std::string dir = argc > 2 ? argv[2] : "/tmp";
+    std::size_t blocks = mib * (1 << 20) / kBlock;
+    std::vector<char> buffer(kBlock, 'x');
+    std::mt19937 rng(42);
+    std::vector<std::size_t> order(blocks);
+    for (std::size_t i = 0; i < blocks; i++) {
+        order[i] = rng() % blocks;
+    }
+    std::printf("%zu MiB file, %zu KiB operations\n", mib, kBlock / 1024);
+
+    {
+        std::string path = dir + "/fs_bench_raw";
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        Run("raw seq write", blocks, [&](std::size_t i) {
+            ::pwrite(fd, buffer.data(), kBlock, i * kBlock);
+        });
+        ::fdatasync(fd);
+        Run("raw seq read", blocks, [&](std::size_t i) {
+            ::pread(fd, buffer.data(), kBlock, i * kBlock);
+        });
+        Run("raw rand read", blocks, [&](std::size_t i) {
+            ::pread(fd, buffer.data(), kBlock, order[i] * kBlock);
+        });
+        Run("raw rand write", blocks, [&](std::size_t i) {
+            ::pwrite(fd, buffer.data(), kBlock, order[i] * kBlock);
+        });
+        ::fdatasync(fd);
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+    {
+        // A cache of a sixteenth of the file, so reads have to go to the image.
+        std::string path = dir + "/fs_bench_image";
+        FS::FileSystem fs(path, blocks / 16);
+        int fd = fs.Open("/file", FS::FileSystem::kCreate);
+        Run("fs seq write", blocks, [&](std::size_t i) {
+            fs.Pwrite(fd, buffer.data(), kBlock, i * kBlock);
+        });
+        fs.Fsync(fd);
+        auto reads = fs.device_reads();
+        Run("fs seq read", blocks, [&](std::size_t i) {
+            fs.Pread(fd, buffer.data(), kBlock, i * kBlock);
+        });
+        std::printf("  %zu device reads, %zu extents\n", fs.device_reads() - reads,
+                    fs.Extents(fd)->size());
+        Run("fs rand read", blocks, [&](std::size_t i) {
+            fs.Pread(fd, buffer.data(), kBlock, order[i] * kBlock);
+        });
+        auto writes = fs.device_writes();
+        Run("fs rand write", blocks, [&](std::size_t i) {
+            fs.Pwrite(fd, buffer.data(), kBlock, order[i] * kBlock);
+        });
+        fs.Fsync(fd);
+        std::printf("  %zu device writes\n", fs.device_writes() - writes);
+        ::unlink(path.c_str());
+    }
+}
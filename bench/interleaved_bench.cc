@@ -0,0 +1,52 @@
+#include "interleaved.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Random lookups in a tree much larger than the cache, one after another
+// with Find and interleaved in groups of growing width with
+// FindInterleaved. Built as C++20 only.
+
+template<typename F>
+void Run(const std::string& name, std::size_t count, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    long found = fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-18s %8.1f ns/lookup (%ld found)\n", name.c_str(),
+                elapsed.count() * 1e9 / count, found);
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 4000000;
+    int lookups = argc > 2 ? std::stoi(argv[2]) : 1000000;
+    std::mt19937 rng(42);
+
+    BTree::Tree<int, int> t;
+    for (int i = 0; i < n; i++) {
+        t.Insert(rng() % (4 * n), i);
+    }
+    std::vector<int> queries;
+    for (int i = 0; i < lookups; i++) {
+        queries.push_back(rng() % (4 * n));
+    }
+
+    std::printf("%d keys, %d lookups\n", n, lookups);
+    Run("Find", queries.size(), [&]() {
+        long found = 0;
+        for (auto key : queries) {
+            found += t.Find(key) != nullptr;
+        }
+        return found;
+    });
+    for (std::size_t group : {1, 2, 4, 8, 12, 16, 24, 32, 64}) {
+        Run("interleaved x" + std::to_string(group), queries.size(), [&]() {
+            long found = 0;
+            for (auto item : BTree::FindInterleaved(t, queries, group)) {
+                found += item != nullptr;
+            }
+            return found;
+        });
+    }
+}
@@ -0,0 +1,56 @@
+#include "btree.h"
+#include "frozen.h"
+#include "static_tree.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Lookups in a small table known at compile time, the case of a
+// configuration map, as a Tree, a FrozenTree and a constexpr StaticTree.
+
+const int kEntries = 64;
+
+template<std::size_t... Is>
+constexpr BTree::StaticTree<int, int, sizeof...(Is)> Build(BTree::IndexSequence<Is...>) {
+    return BTree::MakeStaticTree<int, int>({{3 * static_cast<int>(Is), static_cast<int>(Is)}...});
+}
+
+constexpr auto kTable = Build(BTree::MakeIndexSequence<kEntries>::Type());
+
+template<typename F>
+void Run(const std::string& name, const std::vector<int>& queries, F find) {
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : queries) {
+        found += find(key);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-14s %8.1f ns/lookup (%ld found)\n", name.c_str(),
+                elapsed.count() * 1e9 / queries.size(), found);
+}
+
+int main(int argc, char** argv) {
+    int lookups = argc > 1 ? std::stoi(argv[1]) : 10000000;
+    std::mt19937 rng(42);
+
+    BTree::Tree<int, int> t;
+    std::vector<int> keys;
+    std::vector<int> values;
+    for (int i = 0; i < kEntries; i++) {
+        t.Insert(3 * i, i);
+        keys.push_back(3 * i);
+        values.push_back(i);
+    }
+    BTree::FrozenTree<int, int> frozen(keys, values);
+    std::vector<int> queries;
+    for (int i = 0; i < lookups; i++) {
+        queries.push_back(rng() % (3 * kEntries));
+    }
+
+    std::printf("%d entries, %d lookups\n", kEntries, lookups);
+    Run("Tree", queries, [&t](int key) { return t.Find(key) != nullptr; });
+    Run("FrozenTree", queries, [&frozen](int key) { return frozen.Find(key) != nullptr; });
+    Run("StaticTree", queries, [](int key) { return kTable.Find(key) != nullptr; });
+}
@@ -0,0 +1,74 @@
+#include "io_backend.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Random 4 KiB reads from a local file, once with blocking preadv and once
+// through io_uring at growing queue depths. The file is opened with O_DIRECT
+// where the filesystem supports it, otherwise the reads come out of the
+// kernel page cache and there is little latency left to overlap.
+
+const std::size_t kBlock = 4096;
+
+void Run(const std::string& name, FS::IOBackend& backend,
+         std::vector<FS::IORequest>& requests) {
+    auto start = std::chrono::steady_clock::now();
+    bool ok = backend.Submit(requests);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-14s %10.0f IOPS %8.2f us/read%s\n", name.c_str(),
+                requests.size() / elapsed.count(), elapsed.count() * 1e6 / requests.size(),
+                ok ? "" : " (errors)");
+}
+
+int main(int argc, char** argv) {
+    std::size_t mib = argc > 1 ? std::stoul(argv[1]) : 1024;
+    std::size_t reads = argc > 2 ? std::stoul(argv[2]) : 20000;
+    std::string path = argc > 3 ? argv[3] : "/tmp/uring_bench";
+    std::size_t blocks = mib * (1 << 20) / kBlock;
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    std::vector<char> chunk(1 << 20, 'x');
+    for (std::size_t i = 0; i < mib; i++) {
+        ::pwrite(fd, chunk.data(), chunk.size(), i * chunk.size());
+    }
+    ::fsync(fd);
+    ::close(fd);
+    fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+    bool direct = fd >= 0;
+    if (!direct) {
+        fd = ::open(path.c_str(), O_RDONLY);
+    }
+    std::printf("%zu MiB file, %zu random reads, %s\n", mib, reads,
+                direct ? "O_DIRECT" : "buffered");
+
+    // O_DIRECT wants aligned buffers.
+    void* memory = nullptr;
+    ::posix_memalign(&memory, kBlock, reads * kBlock);
+    char* buffers = static_cast<char*>(memory);
+    std::mt19937 rng(42);
+    std::vector<FS::IORequest> requests(reads);
+    for (std::size_t i = 0; i < reads; i++) {
+        requests[i].offset = (rng() % blocks) * kBlock;
+        requests[i].iov.push_back({buffers + i * kBlock, kBlock});
+    }
+
+    FS::SyncBackend sync(fd);
+    Run("sync", sync, requests);
+    for (unsigned depth = 1; depth <= 128; depth *= 2) {
+        auto uring = FS::UringBackend::Create(fd, depth);
+        if (uring == nullptr) {
+            std::printf("io_uring is not available\n");
+            break;
+        }
+        Run("io_uring qd=" + std::to_string(depth), *uring, requests);
+    }
+    std::free(buffers);
+    ::close(fd);
+    ::unlink(path.c_str());
+}
@@ -0,0 +1,88 @@
+#include "btree.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Zipf distributed lookups, where a few thousand keys take most of the
+// traffic, with and without the hot cache. A scan over all keys halfway
+// through checks that keys read once do not push the hot ones out.
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^s.
+class Zipf {
+    public:
+        Zipf(std::size_t n, double s) : cdf_(n) {
+            double sum = 0;
+            for (std::size_t i = 0; i < n; i++) {
+                sum += 1 / std::pow(i + 1, s);
+                cdf_[i] = sum;
+            }
+            for (auto& p : cdf_) {
+                p /= sum;
+            }
+        }
+
+        template<typename Rng>
+        std::size_t operator()(Rng& rng) {
+            double u = std::uniform_real_distribution<double>(0, 1)(rng);
+            auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+            return std::min<std::size_t>(it - cdf_.begin(), cdf_.size() - 1);
+        }
+
+    private:
+        std::vector<double> cdf_;
+};
+
+template<typename F>
+void Run(const std::string& name, const std::vector<int>& queries, F find) {
+    long found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto key : queries) {
+        found += find(key);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("%-14s %8.1f ns/lookup (%ld found)\n", name.c_str(),
+                elapsed.count() * 1e9 / queries.size(), found);
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::stoi(argv[1]) : 1000000;
+    int lookups = argc > 2 ? std::stoi(argv[2]) : 4000000;
+    double s = argc > 3 ? std::stod(argv[3]) : 0.99;
+    std::size_t capacity = argc > 4 ? std::stoul(argv[4]) : 4096;
+    std::mt19937 rng(42);
+
+    // Keys in random order, so that hot keys are spread over the tree.
+    std::vector<int> keys(n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    BTree::Tree<int, int> plain;
+    BTree::Tree<int, int> cached;
+    for (int i = 0; i < n; i++) {
+        plain.Insert(keys[i], i);
+        cached.Insert(keys[i], i);
+    }
+    cached.EnableHotCache(capacity);
+
+    Zipf zipf(n, s);
+    std::vector<int> queries;
+    for (int i = 0; i < lookups; i++) {
+        queries.push_back(keys[zipf(rng)]);
+        if (i == lookups / 2) {
+            for (int key = 0; key < n; key++) {
+                queries.push_back(key);
+            }
+        }
+    }
+
+    std::printf("%d keys, zipf s=%.2f, cache of %zu items\n", n, s, capacity);
+    Run("Find", queries, [&plain](int key) { return plain.Find(key) != nullptr; });
+    Run("Find + cache", queries, [&cached](int key) { return cached.Find(key) != nullptr; });
+    auto stats = cached.hot_cache()->stats();
+    std::printf("hit rate %.3f, %zu admitted, %zu rejected\n", stats.HitRate(),
+                stats.admissions, stats.rejections);
+}
@@ -0,0 +1,125 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BTree {
+
+    // Spreads the bits of a hash, std::hash of integers is the identity.
+    inline std::uint64_t MixHash(std::uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccd;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    struct BloomStats {
+        std::size_t queries = 0;
+        // Queries answered with "not there".
+        std::size_t negatives = 0;
+        // Queries that passed the filter for keys that were not there.
+        std::size_t false_positives = 0;
+        std::size_t rebuilds = 0;
+
+        // Share of the absent keys the filter let through.
+        double FalsePositiveRate() const {
+            std::size_t absent = negatives + false_positives;
+            return absent == 0 ? 0 : static_cast<double>(false_positives) / absent;
+        }
+    };
+
+    /* BloomFilter is a blocked Bloom filter over 64-bit hashes. The upper
+     * half of a hash picks a block of eight 32-bit words, the lower half
+     * sets one bit in each word of it, so a query reads a single 32 byte
+     * block instead of k random cache lines. With kBitsPerKey bits per key
+     * about one absent key in a hundred gets through.
+     *
+     * Keys cannot be removed, the owner counts deletes and rebuilds the
+     * filter once NeedsRebuild says that it has worn out.
+     */
+    class BloomFilter {
+        public:
+            static const std::size_t kBitsPerKey = 10;
+            static const std::size_t kWordsPerBlock = 8;
+
+            explicit BloomFilter(std::size_t capacity) { Reset(capacity); }
+
+            // Clears the filter and sizes it for capacity keys, the stats
+            // are kept.
+            void Reset(std::size_t capacity) {
+                capacity_ = capacity == 0 ? 1 : capacity;
+                std::size_t blocks = (capacity_ * kBitsPerKey + 255) / 256;
+                words_.assign(blocks * kWordsPerBlock, 0);
+                keys_ = 0;
+                deleted_ = 0;
+                stale_ = false;
+            }
+
+            void Add(std::uint64_t hash) {
+                std::uint32_t* block = Block(hash);
+                for (std::size_t i = 0; i < kWordsPerBlock; i++) {
+                    block[i] |= Bit(hash, i);
+                }
+                keys_++;
+            }
+
+            bool MayContain(std::uint64_t hash) {
+                const std::uint32_t* block = Block(hash);
+                std::uint32_t missing = 0;
+                for (std::size_t i = 0; i < kWordsPerBlock; i++) {
+                    missing |= ~block[i] & Bit(hash, i);
+                }
+                stats_.queries++;
+                if (missing != 0) {
+                    stats_.negatives++;
+                    return false;
+                }
+                return true;
+            }
+
+            void RecordFalsePositive() { stats_.false_positives++; }
+            void RecordDelete() { deleted_++; }
+            void RecordRebuild() { stats_.rebuilds++; }
+            // Marks the filter as worn out, for changes it cannot follow.
+            void Invalidate() { stale_ = true; }
+
+            // Once a quarter of the keys are deleted, or more keys were
+            // added than it was sized for.
+            bool NeedsRebuild() const {
+                return stale_ || keys_ > capacity_ || 4 * deleted_ > keys_;
+            }
+
+            std::size_t capacity() const { return capacity_; }
+            std::size_t keys() const { return keys_; }
+            std::size_t bytes() const { return words_.size() * sizeof(std::uint32_t); }
+            const BloomStats& stats() const { return stats_; }
+
+        private:
+            std::uint32_t* Block(std::uint64_t hash) {
+                std::size_t blocks = words_.size() / kWordsPerBlock;
+                std::size_t block = ((hash >> 32) * blocks) >> 32;
+                return &words_[block * kWordsPerBlock];
+            }
+
+            static std::uint32_t Bit(std::uint64_t hash, std::size_t i) {
+                static const std::uint32_t kSalt[kWordsPerBlock] = {
+                    0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+                    0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31
+                };
+                return std::uint32_t(1) << ((static_cast<std::uint32_t>(hash) * kSalt[i]) >> 27);
+            }
+
+            std::vector<std::uint32_t> words_;
+            std::size_t capacity_ = 0;
+            std::size_t keys_ = 0;
+            std::size_t deleted_ = 0;
+            bool stale_ = false;
+            BloomStats stats_;
+    };
+} // namespace BTree
+
+#endif // BLOOM_H
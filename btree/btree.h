@@ -6,8 +6,14 @@
 #include <iostream>
 #include <functional>
 #include <algorithm>
+#include <memory>
 #include <utility>
 
+#include "bloom.h"
+#include "frozen.h"
+#include "hot_cache.h"
+#include "static_tree.h"
+
 namespace BTree {
 
     template<typename K = int, typename V = int>
@@ -25,6 +31,9 @@ namespace BTree {
             using KeyType = K;
             using ItemT = Item<K, V>;
             using NodeT = Node<K, V>;
+            // Detached subtree together with its height, the height of an
+            // empty subtree (nullptr) is zero.
+            using SubtreeT = std::pair<Node<K, V>*, int>;
 
             // default constructor is deleted.
             Node() = delete;
@@ -35,10 +44,30 @@ namespace BTree {
             std::string ToString();
 
             ItemT* Find(KeyType key);
-            void Insert(KeyType key, ValueType value, bool assure);
-            void Delete(KeyType key, ItemT* to_replace=nullptr);
+            // Item with the largest key not greater than key, or best.
+            ItemT* Floor(KeyType key, ItemT* best=nullptr);
+            // Node holding key, or the leaf where it would be inserted.
+            Node* Locate(KeyType key);
+            // Closest ancestor (or this node) whose subtree covers key.
+            Node* Climb(KeyType key);
+            // Insert and Delete return the leaf that gained or lost an
+            // item, or nullptr if nothing was deleted.
+            Node* Insert(KeyType key, ValueType value, bool assure);
+            Node* Delete(KeyType key);
+            // Adds an item after the last one of this rightmost leaf and
+            // splits overflowing nodes bottom-up. Returns the new rightmost
+            // leaf, count keeps the subtree sizes up to date.
+            Node* Append(KeyType key, ValueType value, bool count);
+
+            // Order statistics, valid only while subtree sizes are kept
+            // up to date (see Tree::EnableOrderStatistics).
+            std::size_t Rank(KeyType key, bool inclusive);
+            ItemT* Select(std::size_t k);
 
             void Traverse(std::function<void(ItemT*)> fn);
+            // In-order walk over the items not smaller than from, stops
+            // and returns false as soon as fn returns false.
+            bool Scan(KeyType from, std::function<bool(ItemT*)> fn);
 
             std::vector<ItemT*> items();
             std::vector<Node<K, V>*> children();
@@ -49,10 +78,38 @@ namespace BTree {
             void SetParent(Node<K, V>* node) { parent_ = node; }
             bool IsLeaf() { return is_leaf_; }
             bool IsRoot() { return parent_ == nullptr; }
+            bool IsFourNode() {
+                return item_->NextItem() != nullptr &&
+                    item_->NextItem()->NextItem() != nullptr;
+            }
             std::pair<Node<K, V>*, Node<K, V>*> Adjacent(Node<K, V>* node);
+            ItemT* FirstItem() { return item_; }
+            ItemT* LastItem();
+
+            // Number of items in the subtree rooted at this node.
+            std::size_t size() { return size_; }
+            void UpdateSize();
+            void AdjustSize(int delta);
+            void UpdateSizes();
+
+            // Joins two subtrees, all keys of left are smaller than the
+            // separator and all keys of right are not. Costs O(height
+            // difference), the taller tree's spine is split on the way down
+            // just like in Insert.
+            static SubtreeT Join(SubtreeT left, ItemT* separator, SubtreeT right);
+            // Splits the subtree rooted at this node of the given height into
+            // keys smaller than key and the rest. This node is reused or freed.
+            std::pair<SubtreeT, SubtreeT> Split(KeyType key, int height);
         private:
             ItemT* GetPrevious(ItemT* item);
+            // Links replacement into the place of item, with its children.
+            void Replace(ItemT* item, ItemT* replacement);
             bool AssureNotFourNode();
+            Node* AssureNotTwoNode();
+            // Move the smallest (largest) item of the subtree into the place
+            // of replaced in owner and free replaced.
+            Node* DeleteMin(ItemT* replaced, Node* owner);
+            Node* DeleteMax(ItemT* replaced, Node* owner);
             bool StealFromSibling(std::pair<Node<K, V>*, Node<K, V>*> siblings);
             void PullUpToParent();
             void FuseLeft(Node<K, V>* sibling);
@@ -62,6 +119,7 @@ namespace BTree {
             ItemT* item_ = nullptr;
             bool is_leaf_ = true;
             Node<K, V>* parent_ = nullptr;
+            std::size_t size_ = 0;
     };
 
     template<typename K, typename V>
@@ -143,18 +201,104 @@ namespace BTree {
 
             Tree() {}
             ~Tree() = default;
+            // Trees own their filter and cache, so they are moved and not
+            // copied. The moved-from tree is left empty, with neither
+            // enabled; assigning frees what the tree held before.
+            Tree(const Tree&) = delete;
+            Tree& operator=(const Tree&) = delete;
+            Tree(Tree&& other) { Swap(other); }
+            Tree& operator=(Tree&& other);
             NodeT* root() { return root_; }
             void Insert(KeyType key, ValueType value);
             void Delete(KeyType key);
             ItemT* Find(KeyType key);
+            // Item with the largest key not greater than key, or nullptr.
+            ItemT* Floor(KeyType key);
+            // Frees all items, the filter and the cache stay enabled.
+            void Clear();
+
+            // Order statistics keep a subtree size in every node. Keeping
+            // them up to date costs a walk to the root on every insert and
+            // delete, so they are only maintained once enabled; the first
+            // query enables them on its own.
+            void EnableOrderStatistics();
+            // Number of keys strictly smaller than key.
+            std::size_t Rank(KeyType key);
+            // k-th smallest item, counting from zero, or nullptr.
+            ItemT* Select(std::size_t k);
+            // Number of keys in [lo, hi].
+            std::size_t CountRange(KeyType lo, KeyType hi);
+
+            // Moves all keys not smaller than key into a new tree.
+            Tree SplitAt(KeyType key);
+            // Moves all items of other into this tree, other is left empty.
+            // None of the keys in other can be smaller than the ones here.
+            void Join(Tree& other);
+
+            // Like Find and Insert, but start from the node touched by the
+            // previous operation and climb only as far as needed, which is
+            // O(log d) for keys d positions away instead of O(log n).
+            ItemT* FindNear(KeyType key);
+            void InsertNear(KeyType key, ValueType value);
+
+            // Visits items from the first key not smaller than from in
+            // order until fn returns false, O(log n + k) for k items.
+            void Scan(KeyType from, std::function<bool(ItemT*)> fn);
+
+            // Immutable pointer-free copy of the tree for read-only use.
+            FrozenTree<K, V> Freeze();
+
+            // Keeps a blocked Bloom filter of the keys next to the tree, so
+            // that Find and FindNear return for most absent keys without
+            // descending. Deleted keys stay in the filter until it is
+            // rebuilt from the tree, which happens once it has worn out.
+            template<typename Hash = std::hash<K>>
+            void EnableBloomFilter();
+            // nullptr unless enabled, the filter has the stats.
+            BloomFilter* bloom_filter() { return bloom_.get(); }
+
+            // Keeps the items of frequently found keys in a small hash
+            // table, so that Find returns them without descending. Items
+            // are not moved by inserts and deletes, only the deleted ones
+            // are erased from it.
+            template<typename Hash = std::hash<K>>
+            void EnableHotCache(std::size_t capacity = 4096);
+            // nullptr unless enabled, the cache has the stats.
+            HotCache<ItemT>* hot_cache() { return cache_.get(); }
+
+            // After this many inserts in a row at the end of the tree, new
+            // keys are appended directly to the rightmost leaf.
+            static const int kAppendStreak = 16;
 
         private:
+            int Height();
+            void CheckRightmost();
+            void Swap(Tree& other);
+            static void Free(NodeT* node);
+            template<typename Hash>
+            static std::uint64_t HashKey(const KeyType& key);
+            // Adds key to the filter, rebuilding it first if it wore out.
+            void BloomInsert(const KeyType& key);
+            void RebuildBloomFilter();
             NodeT* root_ = nullptr;
+            // Node touched by the last operation, reset whenever nodes
+            // might get freed.
+            NodeT* finger_ = nullptr;
+            // Rightmost leaf, nullptr when it has to be looked up again.
+            NodeT* rightmost_ = nullptr;
+            int append_streak_ = 0;
+            bool order_statistics_ = false;
+            std::unique_ptr<BloomFilter> bloom_;
+            std::unique_ptr<HotCache<ItemT>> cache_;
+            // Each structure hashes with the Hash it was enabled with.
+            std::uint64_t (*bloom_hash_)(const KeyType&) = nullptr;
+            std::uint64_t (*cache_hash_)(const KeyType&) = nullptr;
     };
 
     template<typename K, typename V>
     Node<K, V>::Node(KeyType key, ValueType value) {
         item_ = new ItemT(key, value);
+        size_ = 1;
     }
 
     template<typename K, typename V>
@@ -165,16 +309,17 @@ namespace BTree {
         ItemT* current = item;
         NodeT* child_node;
         while(current != nullptr) {
-            child_node = item->right();
+            child_node = current->right();
             if (child_node != nullptr) {
                 child_node->SetParent(this);
             }
-            child_node = item->left();
+            child_node = current->left();
             if (child_node != nullptr) {
                 child_node->SetParent(this);
             }
             current = current->NextItem();
         }
+        UpdateSize();
     }
 
     template<typename K, typename V>
@@ -214,6 +359,86 @@ namespace BTree {
         return nullptr;
     }
 
+    template<typename K, typename V>
+    Item<K, V>* Node<K, V>::Floor(KeyType key, ItemT* best) {
+        ItemT* current = item_;
+        while (current != nullptr) {
+            if (key < current->key()) {
+                return IsLeaf() ? best : current->left()->Floor(key, best);
+            }
+            best = current;
+            ItemT* next = current->NextItem();
+            if (next == nullptr && !IsLeaf()) {
+                return current->right()->Floor(key, best);
+            }
+            current = next;
+        }
+        return best;
+    }
+
+    template<typename K, typename V>
+    Node<K, V>* Node<K, V>::Locate(KeyType key) {
+        ItemT* current = item_;
+        while (current != nullptr) {
+            if (key == current->key()) {
+                return this;
+            }
+            if (key < current->key()) {
+                return IsLeaf() ? this : current->left()->Locate(key);
+            }
+            ItemT* next = current->NextItem();
+            if (next == nullptr && !IsLeaf()) {
+                return current->right()->Locate(key);
+            }
+            current = next;
+        }
+        return this;
+    }
+
+    template<typename K, typename V>
+    Node<K, V>* Node<K, V>::Climb(KeyType key) {
+        // A node covers the keys between the parent items around it. A
+        // first child has no parent item on its left and covers the same
+        // small keys as its parent, a last child likewise on its right, so
+        // a bound is only settled by the first node up the path that has
+        // an item or a parent item on that side, or by the root, and then
+        // holds for the nodes below it that had none. That way keys past
+        // either end of the tree stay on the spine they started from.
+        // Keys equal to an item go right, so the upper bounds are strict.
+        Node* lower = this;
+        Node* upper = this;
+        int lower_level = 0;
+        int upper_level = 0;
+        bool above = false;
+        bool below = false;
+        Node* node = this;
+        for (int level = 0; !above || !below; level++, node = node->parent_) {
+            if (!above) {
+                ItemT* bound = nullptr;
+                above = node->IsRoot() || !(key < node->item_->key());
+                if (!above && (bound = node->GetLeftParentItem()) != nullptr) {
+                    above = bound->key() < key;
+                    if (!above) {
+                        lower = node->parent_;
+                        lower_level = level + 1;
+                    }
+                }
+            }
+            if (!below) {
+                ItemT* bound = nullptr;
+                below = node->IsRoot() || key < node->LastItem()->key();
+                if (!below && (bound = node->GetRightParentItem()) != nullptr) {
+                    below = key < bound->key();
+                    if (!below) {
+                        upper = node->parent_;
+                        upper_level = level + 1;
+                    }
+                }
+            }
+        }
+        return lower_level > upper_level ? lower : upper;
+    }
+
     template<typename K, typename V>
     bool Node<K, V>::AssureNotFourNode() {
         ItemT* current = item_;
@@ -252,7 +477,7 @@ namespace BTree {
         ItemT* previous = nullptr;
         current = parent_->item_;
         while (current != nullptr) {
-            if (middle->key() < current->key()) {
+            if (current->left() == this) {
                 break;
             }
             previous = current;
@@ -263,6 +488,7 @@ namespace BTree {
         new_right = new Node(right_item, parent_, IsLeaf());
         new_left = this;
         item_->SetNext(nullptr);
+        UpdateSize();
 
         middle->SetLeft(new_left);
         middle->SetNext(nullptr);
@@ -284,7 +510,7 @@ namespace BTree {
 
 
     template<typename K, typename V>
-    void Node<K, V>::Insert(KeyType key, ValueType value, bool assure) {
+    Node<K, V>* Node<K, V>::Insert(KeyType key, ValueType value, bool assure) {
         // make sure that the node has less than three items.
         if (assure) {
             bool changed = AssureNotFourNode();
@@ -309,7 +535,7 @@ namespace BTree {
                     item->SetNext(current);
                     previous->SetNext(item);
                 }
-                return;
+                return this;
             }
             ItemT* next = current->NextItem();
             if (next == nullptr) {
@@ -318,11 +544,49 @@ namespace BTree {
                 }
                 ItemT* item = new ItemT(key, value);
                 current->SetNext(item);
-                return;
+                return this;
             }
             previous = current;
             current = next;
         }
+        return nullptr;
+    }
+
+    template<typename K, typename V>
+    Node<K, V>* Node<K, V>::Append(KeyType key, ValueType value, bool count) {
+        LastItem()->SetNext(new ItemT(key, value));
+        Node* leaf = this;
+        Node* node = this;
+        while (true) {
+            ItemT* second = node->item_->NextItem();
+            ItemT* middle = second == nullptr ? nullptr : second->NextItem();
+            ItemT* last = middle == nullptr ? nullptr : middle->NextItem();
+            if (last == nullptr) {
+                break;
+            }
+            // Split [a, b, c, d] into [a, b] c [d]. Unlike the even split
+            // in AssureNotFourNode this leaves the left node as full as a
+            // 2-3-4 node can be after a split, appends never come back to it.
+            second->SetNext(nullptr);
+            middle->SetNext(nullptr);
+            Node* right = new Node(last, node->parent_, node->IsLeaf());
+            middle->SetLeft(node);
+            middle->SetRight(right);
+            node->UpdateSize();
+            if (node == leaf) {
+                leaf = right;
+            }
+            if (node->IsRoot()) {
+                new Node(middle, nullptr, false);
+                return leaf;
+            }
+            node = node->parent_;
+            node->LastItem()->SetNext(middle);
+        }
+        if (count) {
+            node->AdjustSize(1);
+        }
+        return leaf;
     }
 
     template<typename K, typename V>
@@ -345,7 +609,7 @@ namespace BTree {
         ItemT* previous = nullptr;
         ItemT* current = item_;
         while (current != nullptr) {
-           if (current->key() >= item->key()) {
+           if (current == item) {
                return previous;
            }
            previous = current;
@@ -354,86 +618,82 @@ namespace BTree {
         return previous;
     }
 
+    template<typename K, typename V>
+    void Node<K, V>::Replace(ItemT* item, ItemT* replacement) {
+        ItemT* previous = GetPrevious(item);
+        if (previous == nullptr) {
+            item_ = replacement;
+        } else {
+            previous->SetNext(replacement);
+        }
+        replacement->SetNext(item->NextItem());
+        replacement->SetLeft(item->left());
+        replacement->SetRight(item->right());
+    }
+
     template<typename K, typename V>
     Item<K, V>* Node<K, V>::GetLeftParentItem() {
-        auto first_key = item_->key();
-        auto all_items = parent_->items();
-        ItemT* previous = nullptr;
-        for (auto item : all_items) {
-           if (item->key() >  first_key) {
-               return previous;
+        // Parent item separating this node from its left sibling.
+        ItemT* current = parent_->item_;
+        while (current != nullptr) {
+           if (current->right() == this) {
+               return current;
            }
-           previous = item;
+           current = current->NextItem();
         }
-        return previous;
+        return nullptr;
     }
 
     template<typename K, typename V>
     Item<K, V>* Node<K, V>::GetRightParentItem() {
-        auto first_key = item_->key();
-        auto all_items = parent_->items();
-        for (auto item : all_items) {
-           if (item->key() >  first_key) {
-               return item;
+        // Parent item separating this node from its right sibling.
+        ItemT* current = parent_->item_;
+        while (current != nullptr) {
+           if (current->left() == this) {
+               return current;
            }
+           current = current->NextItem();
         }
         return nullptr;
     }
 
     template<typename K, typename V>
-    void Node<K, V>::Delete(KeyType key, ItemT* to_replace) {
-        // Eliminate 1-key nodes. (other than the root).
+    Node<K, V>* Node<K, V>::AssureNotTwoNode() {
+        // Eliminate 1-key nodes (other than the root) on the way down, so
+        // that removing an item from a leaf never leaves it empty.
         // Rules for deletion are well described in a wikipedia article:
         // https://en.wikipedia.org/wiki/2%E2%80%933%E2%80%934_tree
-        if (items().size() == 1) {
-            if (!IsRoot()) {
-                auto siblings = parent_->Adjacent(this);
-                bool stolen = StealFromSibling(siblings);
-                // if not rotated, try something else
-                if (!stolen) {
-                    // can either pull up to parent
-                    if (parent_->items().size() == 1) {
-                        PullUpToParent();
-                        return parent_->Delete(key, to_replace);
-                    }
-                    if (siblings.first != nullptr) {
-                        FuseLeft(siblings.first);
-                    } else {
-                        FuseRight(siblings.second);
-                    }
-                }
-            }
+        if (IsRoot() || item_->NextItem() != nullptr) {
+            return this;
         }
+        auto siblings = parent_->Adjacent(this);
+        if (StealFromSibling(siblings)) {
+            return this;
+        }
+        // Only the root can be a 1-key parent, pull both children into it.
+        Node* parent = parent_;
+        if (parent->item_->NextItem() == nullptr) {
+            PullUpToParent();
+            return parent;
+        }
+        if (siblings.first != nullptr) {
+            FuseLeft(siblings.first);
+        } else {
+            FuseRight(siblings.second);
+        }
+        return this;
+    }
 
-        if (!IsLeaf()) {
-            ItemT* previous = nullptr;
-            ItemT* current = item_;
-            while(current != nullptr) {
-                if (key == current->key()) {
-                    // find successor and rotate all the way.
-                    return current->right()->Delete(key, current);
-                } else if (key < current->key()) {
-                    return current->left()->Delete(key);
-                } else if (current->NextItem() == nullptr) {
-                    return current->right()->Delete(key);
-                } else {
-                    previous = current;
-                    current = current->NextItem();
-                }
-            }
+    template<typename K, typename V>
+    Node<K, V>* Node<K, V>::Delete(KeyType key) {
+        Node* node = AssureNotTwoNode();
+        if (node != this) {
+            return node->Delete(key);
         }
 
+        ItemT* previous = nullptr;
+        ItemT* current = item_;
         if (IsLeaf()) {
-            ItemT* previous = nullptr;
-            ItemT* current = item_;
-            if (to_replace != nullptr) {
-                to_replace->SetKey(current->key());
-                to_replace->SetValue(current->value());
-                item_ = current->NextItem();
-                delete current;
-                return;
-            }
-
             while(current != nullptr) {
                 if (key == current->key()) {
                     if (previous == nullptr) {
@@ -442,17 +702,80 @@ namespace BTree {
                         previous->SetNext(current->NextItem());
                     }
                     delete current;
-                    return;
+                    return this;
                 }
-
                 previous = current;
                 current = current->NextItem();
             }
+            return nullptr;
         }
+
+        while(current != nullptr) {
+            if (key == current->key()) {
+                // Replace the item with its predecessor or successor, taken
+                // from whichever neighbour can spare an item. Items are
+                // relinked rather than copied, so that pointers to the
+                // items that stay in the tree remain valid.
+                Node* left = current->left();
+                Node* right = current->right();
+                if (left->item_->NextItem() != nullptr) {
+                    return left->DeleteMax(current, this);
+                }
+                if (right->item_->NextItem() != nullptr) {
+                    return right->DeleteMin(current, this);
+                }
+                // Both are 2-nodes, fuse them around the item and retry.
+                if (item_->NextItem() == nullptr) {
+                    left->PullUpToParent();
+                    return Delete(key);
+                }
+                left->FuseRight(right);
+                return left->Delete(key);
+            } else if (key < current->key()) {
+                return current->left()->Delete(key);
+            } else if (current->NextItem() == nullptr) {
+                return current->right()->Delete(key);
+            }
+            current = current->NextItem();
+        }
+        return nullptr;
+    }
+
+    template<typename K, typename V>
+    Node<K, V>* Node<K, V>::DeleteMin(ItemT* replaced, Node* owner) {
+        AssureNotTwoNode();
+        if (!IsLeaf()) {
+            return item_->left()->DeleteMin(replaced, owner);
+        }
+        ItemT* first = item_;
+        item_ = first->NextItem();
+        owner->Replace(replaced, first);
+        delete replaced;
+        return this;
+    }
+
+    template<typename K, typename V>
+    Node<K, V>* Node<K, V>::DeleteMax(ItemT* replaced, Node* owner) {
+        AssureNotTwoNode();
+        ItemT* previous = nullptr;
+        ItemT* last = item_;
+        while (last->NextItem() != nullptr) {
+            previous = last;
+            last = last->NextItem();
+        }
+        if (!IsLeaf()) {
+            return last->right()->DeleteMax(replaced, owner);
+        }
+        previous->SetNext(nullptr);
+        owner->Replace(replaced, last);
+        delete replaced;
+        return this;
     }
 
     template<typename K, typename V>
     bool Node<K, V>::StealFromSibling(std::pair<Node*, Node*> siblings) {
+        // The sibling's item moves up into the parent and the parent item
+        // down into this node, both keep their identity.
         bool has_stolen = false;
         if (siblings.first != nullptr && siblings.first->items().size() > 1) {
             auto sibling_size = siblings.first->items().size();
@@ -460,29 +783,38 @@ namespace BTree {
             ItemT* before_last = siblings.first->items()[sibling_size - 2];
             before_last->SetNext(nullptr);
             ItemT* left_parent_item = GetLeftParentItem();
-            ItemT* stolen = new ItemT(left_parent_item->key(), left_parent_item->value());
-            left_parent_item->SetKey(last->key());
-            left_parent_item->SetValue(last->value());
-
-            stolen->SetNext(item_);
-            stolen->SetLeft(last->right());
-            stolen->SetRight(item_->left());
-            item_ = stolen;
-            delete last;
+            Node* moved = last->right();
+            parent_->Replace(left_parent_item, last);
+
+            left_parent_item->SetNext(item_);
+            left_parent_item->SetLeft(moved);
+            left_parent_item->SetRight(item_->left());
+            if (moved != nullptr) {
+                moved->SetParent(this);
+            }
+            item_ = left_parent_item;
+            siblings.first->UpdateSize();
             has_stolen = true;
         } else if(siblings.second != nullptr && siblings.second->items().size() > 1) {
             ItemT* first = siblings.second->item_;
-            ItemT* right_parent_item = GetRightParentItem();
-            ItemT* stolen = new ItemT(right_parent_item->key(), right_parent_item->value());
-            right_parent_item->SetKey(first->key());
-            right_parent_item->SetValue(first->value());
-            stolen->SetRight(first->left());
-            stolen->SetLeft(item_->right());
-            item_->SetNext(stolen);
             siblings.second->item_ = first->NextItem();
-            delete first;
+            ItemT* right_parent_item = GetRightParentItem();
+            Node* moved = first->left();
+            parent_->Replace(right_parent_item, first);
+
+            right_parent_item->SetNext(nullptr);
+            right_parent_item->SetRight(moved);
+            right_parent_item->SetLeft(item_->right());
+            if (moved != nullptr) {
+                moved->SetParent(this);
+            }
+            item_->SetNext(right_parent_item);
+            siblings.second->UpdateSize();
             has_stolen = true;
         }
+        if (has_stolen) {
+            UpdateSize();
+        }
         return has_stolen;
     }
 
@@ -507,6 +839,7 @@ namespace BTree {
         parent_item->SetLeft(left->right());
         parent_item->SetRight(right->left());
         delete sibling;
+        UpdateSize();
     }
 
     template<typename K, typename V>
@@ -531,6 +864,7 @@ namespace BTree {
         parent_item->SetLeft(left->right());
         parent_item->SetRight(right->left());
         delete sibling;
+        UpdateSize();
     }
 
     template<typename K, typename V>
@@ -548,14 +882,13 @@ namespace BTree {
         middle->SetRight(right->left());
         middle->SetLeft(left->right());
 
-        if (left_node->IsLeaf()) {
-            is_leaf_ = true;
-        }
+        parent_->is_leaf_ = left_node->IsLeaf();
         left->SetNext(middle);
         middle->SetNext(right);
+        parent_->item_ = left;
+        // This node is one of the two being deleted.
         delete left_node;
         delete right_node;
-        parent_->item_ = left;
     }
 
     template<typename K, typename V>
@@ -595,6 +928,27 @@ namespace BTree {
         }
     }
 
+    template<typename K, typename V>
+    bool Node<K, V>::Scan(KeyType from, std::function<bool(ItemT*)> fn) {
+        ItemT* current = item_;
+        while (current != nullptr) {
+            if (!(current->key() < from)) {
+                if (!IsLeaf() && !current->left()->Scan(from, fn)) {
+                    return false;
+                }
+                if (!fn(current)) {
+                    return false;
+                }
+            }
+            ItemT* next = current->NextItem();
+            if (next == nullptr && !IsLeaf()) {
+                return current->right()->Scan(from, fn);
+            }
+            current = next;
+        }
+        return true;
+    }
+
     template<typename K, typename V>
     std::vector<Item<K, V>*> Node<K, V>::items() {
         std::vector<ItemT*> all_items;
@@ -607,6 +961,226 @@ namespace BTree {
 
     }
 
+    template<typename K, typename V>
+    void Node<K, V>::UpdateSize() {
+        size_ = 0;
+        ItemT* current = item_;
+        if (!IsLeaf() && current != nullptr) {
+            size_ += current->left()->size();
+        }
+        while (current != nullptr) {
+            size_++;
+            if (!IsLeaf()) {
+                size_ += current->right()->size();
+            }
+            current = current->NextItem();
+        }
+    }
+
+    template<typename K, typename V>
+    void Node<K, V>::AdjustSize(int delta) {
+        Node* current = this;
+        while (current != nullptr) {
+            current->size_ += delta;
+            current = current->parent();
+        }
+    }
+
+    template<typename K, typename V>
+    void Node<K, V>::UpdateSizes() {
+        for (auto child : children()) {
+            child->UpdateSizes();
+        }
+        UpdateSize();
+    }
+
+    template<typename K, typename V>
+    std::size_t Node<K, V>::Rank(KeyType key, bool inclusive) {
+        std::size_t rank = 0;
+        ItemT* current = item_;
+        while (current != nullptr) {
+            bool go_left = inclusive ? key < current->key() : !(current->key() < key);
+            if (go_left) {
+                if (!IsLeaf()) {
+                    rank += current->left()->Rank(key, inclusive);
+                }
+                return rank;
+            }
+            rank += 1;
+            if (!IsLeaf()) {
+                rank += current->left()->size();
+            }
+            ItemT* next = current->NextItem();
+            if (next == nullptr && !IsLeaf()) {
+                return rank + current->right()->Rank(key, inclusive);
+            }
+            current = next;
+        }
+        return rank;
+    }
+
+    template<typename K, typename V>
+    Item<K, V>* Node<K, V>::Select(std::size_t k) {
+        ItemT* current = item_;
+        while (current != nullptr) {
+            if (!IsLeaf()) {
+                std::size_t left_size = current->left()->size();
+                if (k < left_size) {
+                    return current->left()->Select(k);
+                }
+                k -= left_size;
+            }
+            if (k == 0) {
+                return current;
+            }
+            k--;
+            ItemT* next = current->NextItem();
+            if (next == nullptr && !IsLeaf()) {
+                return current->right()->Select(k);
+            }
+            current = next;
+        }
+        return nullptr;
+    }
+
+    template<typename K, typename V>
+    Item<K, V>* Node<K, V>::LastItem() {
+        ItemT* current = item_;
+        while (current->NextItem() != nullptr) {
+            current = current->NextItem();
+        }
+        return current;
+    }
+
+    template<typename K, typename V>
+    typename Node<K, V>::SubtreeT Node<K, V>::Join(
+            SubtreeT left, ItemT* separator, SubtreeT right) {
+        separator->SetNext(nullptr);
+        if (left.second == right.second) {
+            separator->SetLeft(left.first);
+            separator->SetRight(right.first);
+            Node* root = new Node(separator, nullptr, left.first == nullptr);
+            return {root, left.second + 1};
+        }
+
+        bool into_left = left.second > right.second;
+        SubtreeT taller = into_left ? left : right;
+        SubtreeT shorter = into_left ? right : left;
+        Node* node = taller.first;
+        int height = taller.second;
+        int level = height;
+        while (true) {
+            bool full = node->items().size() == 3;
+            if (node->AssureNotFourNode()) {
+                // Split node keeps the left half, follow the right spine.
+                if (into_left) {
+                    node = node->GetRightParentItem()->right();
+                }
+            } else if (full) {
+                // The root was split in place and grew by one level.
+                height++;
+                level++;
+            }
+            if (level == shorter.second + 1) {
+                break;
+            }
+            node = into_left ? node->LastItem()->right() : node->item_->left();
+            level--;
+        }
+
+        if (into_left) {
+            ItemT* last = node->LastItem();
+            separator->SetLeft(last->right());
+            separator->SetRight(shorter.first);
+            last->SetNext(separator);
+        } else {
+            separator->SetLeft(shorter.first);
+            separator->SetRight(node->item_->left());
+            separator->SetNext(node->item_);
+            node->item_ = separator;
+        }
+        std::size_t added = 1;
+        if (shorter.first != nullptr) {
+            shorter.first->SetParent(node);
+            added += shorter.first->size();
+        }
+        node->AdjustSize(added);
+        return {taller.first, height};
+    }
+
+    template<typename K, typename V>
+    std::pair<typename Node<K, V>::SubtreeT, typename Node<K, V>::SubtreeT>
+    Node<K, V>::Split(KeyType key, int height) {
+        // Items before position go left, the others go right.
+        std::vector<ItemT*> all = items();
+        std::size_t position = 0;
+        while (position < all.size() && all[position]->key() < key) {
+            position++;
+        }
+        parent_ = nullptr;
+
+        if (IsLeaf()) {
+            SubtreeT left = {nullptr, 0};
+            SubtreeT right = {nullptr, 0};
+            if (position > 0) {
+                all[position - 1]->SetNext(nullptr);
+                left = {this, 1};
+                UpdateSize();
+            }
+            if (position < all.size()) {
+                right = {position > 0 ? new Node(all[position], nullptr, true) : this, 1};
+            }
+            return {left, right};
+        }
+
+        // Split the child on the path of key, then join the pieces on both
+        // sides of the path back together with the items of this node.
+        Node* path = position < all.size() ?
+            all[position]->left() : all[position - 1]->right();
+        auto halves = path->Split(key, height - 1);
+        bool reused = false;
+
+        SubtreeT left = halves.first;
+        if (position > 0) {
+            SubtreeT rest;
+            if (position == 1) {
+                rest = {all[0]->left(), height - 1};
+                rest.first->SetParent(nullptr);
+            } else {
+                all[position - 2]->SetNext(nullptr);
+                UpdateSize();
+                rest = {this, height};
+                reused = true;
+            }
+            left = Join(rest, all[position - 1], left);
+        }
+
+        SubtreeT right = halves.second;
+        if (position < all.size()) {
+            SubtreeT rest;
+            if (position + 1 == all.size()) {
+                rest = {all[position]->right(), height - 1};
+                rest.first->SetParent(nullptr);
+            } else {
+                Node* node = this;
+                if (reused) {
+                    node = new Node(all[position + 1], nullptr, false);
+                } else {
+                    item_ = all[position + 1];
+                    UpdateSize();
+                    reused = true;
+                }
+                rest = {node, height};
+            }
+            right = Join(right, all[position], rest);
+        }
+
+        if (!reused) {
+            delete this;
+        }
+        return {left, right};
+    }
+
     template<typename K, typename V>
     std::string Item<K, V>::ToString() {
         return "<Item: " + std::to_string(key_) + ", " + std::to_string(value_) + ">";
@@ -619,21 +1193,414 @@ namespace BTree {
 
     template<typename K, typename V>
     void Tree<K, V>::Insert(KeyType key, ValueType value) {
+        if (bloom_ != nullptr) {
+            BloomInsert(key);
+        }
         if(root_ == nullptr) {
             root_ = new Node<K, V>(key, value);
-        } else {
-            root_->Insert(key, value, true);
+            return;
+        }
+        if (rightmost_ == nullptr) {
+            rightmost_ = root_;
+            while (!rightmost_->IsLeaf()) {
+                rightmost_ = rightmost_->LastItem()->right();
+            }
+        }
+        if (key < rightmost_->LastItem()->key()) {
+            append_streak_ = 0;
+        } else if (++append_streak_ >= kAppendStreak) {
+            rightmost_ = rightmost_->Append(key, value, order_statistics_);
+            finger_ = rightmost_;
+            if (!root_->IsRoot()) {
+                root_ = root_->parent();
+            }
+            return;
+        }
+
+        NodeT* leaf = root_->Insert(key, value, true);
+        if (order_statistics_) {
+            leaf->AdjustSize(1);
+        }
+        finger_ = leaf;
+        CheckRightmost();
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::Scan(KeyType from, std::function<bool(ItemT*)> fn) {
+        if (root_ != nullptr) {
+            root_->Scan(from, fn);
+        }
+    }
+
+    template<typename K, typename V>
+    FrozenTree<K, V> Tree<K, V>::Freeze() {
+        std::vector<KeyType> keys;
+        std::vector<ValueType> values;
+        if (root_ != nullptr) {
+            root_->Traverse([&keys, &values](ItemT* item) {
+                keys.push_back(item->key());
+                values.push_back(item->value());
+            });
+        }
+        return FrozenTree<K, V>(keys, values);
+    }
+
+    template<typename K, typename V>
+    Tree<K, V>& Tree<K, V>::operator=(Tree&& other) {
+        if (this != &other) {
+            Clear();
+            order_statistics_ = false;
+            bloom_.reset();
+            cache_.reset();
+            bloom_hash_ = nullptr;
+            cache_hash_ = nullptr;
+            Swap(other);
+        }
+        return *this;
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::Clear() {
+        if (root_ != nullptr) {
+            Free(root_);
+        }
+        root_ = nullptr;
+        finger_ = nullptr;
+        rightmost_ = nullptr;
+        append_streak_ = 0;
+        if (cache_ != nullptr) {
+            cache_->Clear();
+        }
+        if (bloom_ != nullptr) {
+            RebuildBloomFilter();
+        }
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::Free(NodeT* node) {
+        for (auto child : node->children()) {
+            Free(child);
+        }
+        for (auto item : node->items()) {
+            delete item;
+        }
+        delete node;
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::Swap(Tree& other) {
+        std::swap(root_, other.root_);
+        std::swap(finger_, other.finger_);
+        std::swap(rightmost_, other.rightmost_);
+        std::swap(append_streak_, other.append_streak_);
+        std::swap(order_statistics_, other.order_statistics_);
+        std::swap(bloom_, other.bloom_);
+        std::swap(cache_, other.cache_);
+        std::swap(bloom_hash_, other.bloom_hash_);
+        std::swap(cache_hash_, other.cache_hash_);
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::CheckRightmost() {
+        // Inserts only move the rightmost leaf by splitting it.
+        if (rightmost_ == nullptr) {
+            return;
+        }
+        if (!rightmost_->IsLeaf() || (!rightmost_->IsRoot() &&
+            rightmost_->parent()->LastItem()->right() != rightmost_)) {
+            rightmost_ = nullptr;
         }
     }
 
     template<typename K, typename V>
     Item<K, V>* Tree<K, V>::Find(KeyType key) {
-        return root_->Find(key);
+        if (root_ == nullptr) {
+            return nullptr;
+        }
+        if (bloom_ == nullptr && cache_ == nullptr) {
+            return root_->Find(key);
+        }
+        std::uint64_t hash = 0;
+        if (cache_ != nullptr) {
+            hash = cache_hash_(key);
+            ItemT* cached = cache_->Find(key, hash);
+            if (cached != nullptr) {
+                return cached;
+            }
+        }
+        if (bloom_ != nullptr) {
+            // Hashed once if both use the same Hash.
+            std::uint64_t bloom_hash = cache_ != nullptr && cache_hash_ == bloom_hash_
+                ? hash : bloom_hash_(key);
+            if (!bloom_->MayContain(bloom_hash)) {
+                return nullptr;
+            }
+        }
+        ItemT* found = root_->Find(key);
+        if (found == nullptr && bloom_ != nullptr) {
+            bloom_->RecordFalsePositive();
+        }
+        if (found != nullptr && cache_ != nullptr) {
+            cache_->Admit(hash, found);
+        }
+        return found;
+    }
+
+    template<typename K, typename V>
+    Item<K, V>* Tree<K, V>::Floor(KeyType key) {
+        if (root_ == nullptr) {
+            return nullptr;
+        }
+        return root_->Floor(key);
     }
 
     template<typename K, typename V>
     void Tree<K, V>::Delete(KeyType key) {
-        return root_->Delete(key);
+        if (root_ == nullptr) {
+            return;
+        }
+        if (cache_ != nullptr) {
+            // Before the item is freed, the cache compares keys through it.
+            cache_->Erase(key, cache_hash_(key));
+        }
+        NodeT* leaf = root_->Delete(key);
+        if (leaf != nullptr && order_statistics_) {
+            leaf->AdjustSize(-1);
+        }
+        if (leaf != nullptr && bloom_ != nullptr) {
+            bloom_->RecordDelete();
+        }
+        finger_ = leaf;
+        rightmost_ = nullptr;
+        if (root_->items().empty()) {
+            delete root_;
+            root_ = nullptr;
+            finger_ = nullptr;
+        }
+        if (bloom_ != nullptr && bloom_->NeedsRebuild()) {
+            RebuildBloomFilter();
+        }
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::EnableOrderStatistics() {
+        if (order_statistics_) {
+            return;
+        }
+        if (root_ != nullptr) {
+            root_->UpdateSizes();
+        }
+        order_statistics_ = true;
+    }
+
+    template<typename K, typename V>
+    std::size_t Tree<K, V>::Rank(KeyType key) {
+        EnableOrderStatistics();
+        if (root_ == nullptr) {
+            return 0;
+        }
+        return root_->Rank(key, false);
+    }
+
+    template<typename K, typename V>
+    Item<K, V>* Tree<K, V>::Select(std::size_t k) {
+        EnableOrderStatistics();
+        if (root_ == nullptr) {
+            return nullptr;
+        }
+        return root_->Select(k);
+    }
+
+    template<typename K, typename V>
+    std::size_t Tree<K, V>::CountRange(KeyType lo, KeyType hi) {
+        EnableOrderStatistics();
+        if (root_ == nullptr || hi < lo) {
+            return 0;
+        }
+        return root_->Rank(hi, true) - root_->Rank(lo, false);
+    }
+
+    template<typename K, typename V>
+    int Tree<K, V>::Height() {
+        int height = 0;
+        NodeT* current = root_;
+        while (current != nullptr) {
+            height++;
+            current = current->IsLeaf() ? nullptr : current->FirstItem()->left();
+        }
+        return height;
+    }
+
+    template<typename K, typename V>
+    Tree<K, V> Tree<K, V>::SplitAt(KeyType key) {
+        Tree upper;
+        upper.order_statistics_ = order_statistics_;
+        if (root_ == nullptr) {
+            return upper;
+        }
+        auto halves = root_->Split(key, Height());
+        if (bloom_ != nullptr) {
+            // Still right, but the keys moved out count as deleted.
+            bloom_->Invalidate();
+        }
+        if (cache_ != nullptr) {
+            cache_->Clear();
+        }
+        finger_ = nullptr;
+        rightmost_ = nullptr;
+        root_ = halves.first.first;
+        upper.root_ = halves.second.first;
+        return upper;
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::Join(Tree& other) {
+        if (other.root_ == nullptr) {
+            return;
+        }
+        if (other.cache_ != nullptr) {
+            other.cache_->Clear();
+        }
+        if (bloom_ != nullptr) {
+            // No rebuilds half way, they would only see the keys here.
+            other.root_->Traverse([this](ItemT* item) {
+                bloom_->Add(bloom_hash_(item->key()));
+            });
+        }
+        if (root_ == nullptr) {
+            std::swap(root_, other.root_);
+            std::swap(finger_, other.finger_);
+            std::swap(rightmost_, other.rightmost_);
+            order_statistics_ = other.order_statistics_;
+            if (bloom_ != nullptr && bloom_->NeedsRebuild()) {
+                RebuildBloomFilter();
+            }
+            return;
+        }
+        // Borrow the smallest item of other as the separator.
+        NodeT* leftmost = other.root_;
+        while (!leftmost->IsLeaf()) {
+            leftmost = leftmost->FirstItem()->left();
+        }
+        KeyType key = leftmost->FirstItem()->key();
+        ValueType value = leftmost->FirstItem()->value();
+        other.Delete(key);
+        order_statistics_ = order_statistics_ && other.order_statistics_;
+        if (other.root_ == nullptr) {
+            return Insert(key, value);
+        }
+        auto joined = NodeT::Join({root_, Height()}, new ItemT(key, value),
+                                  {other.root_, other.Height()});
+        root_ = joined.first;
+        rightmost_ = nullptr;
+        other.root_ = nullptr;
+        other.finger_ = nullptr;
+        other.rightmost_ = nullptr;
+        if (bloom_ != nullptr && bloom_->NeedsRebuild()) {
+            RebuildBloomFilter();
+        }
+    }
+
+    template<typename K, typename V>
+    Item<K, V>* Tree<K, V>::FindNear(KeyType key) {
+        if (root_ == nullptr) {
+            return nullptr;
+        }
+        if (bloom_ != nullptr && !bloom_->MayContain(bloom_hash_(key))) {
+            return nullptr;
+        }
+        NodeT* start = finger_ == nullptr ? root_ : finger_->Climb(key);
+        finger_ = start->Locate(key);
+        ItemT* current = finger_->FirstItem();
+        while (current != nullptr) {
+            if (key == current->key()) {
+                return current;
+            }
+            current = current->NextItem();
+        }
+        if (bloom_ != nullptr) {
+            bloom_->RecordFalsePositive();
+        }
+        return nullptr;
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::InsertNear(KeyType key, ValueType value) {
+        if (finger_ == nullptr) {
+            return Insert(key, value);
+        }
+        if (bloom_ != nullptr) {
+            BloomInsert(key);
+        }
+        NodeT* start = finger_->Climb(key);
+        // A full start node gets split into its parent, so that one needs
+        // room for the middle item.
+        while (!start->IsRoot() && start->IsFourNode() &&
+               start->parent()->IsFourNode()) {
+            start = start->parent();
+        }
+        NodeT* leaf = start->Insert(key, value, true);
+        if (order_statistics_) {
+            leaf->AdjustSize(1);
+        }
+        finger_ = leaf;
+        CheckRightmost();
+    }
+
+    template<typename K, typename V>
+    template<typename Hash>
+    void Tree<K, V>::EnableBloomFilter() {
+        if (bloom_ != nullptr) {
+            return;
+        }
+        bloom_hash_ = &HashKey<Hash>;
+        RebuildBloomFilter();
+    }
+
+    template<typename K, typename V>
+    template<typename Hash>
+    void Tree<K, V>::EnableHotCache(std::size_t capacity) {
+        if (cache_ != nullptr) {
+            return;
+        }
+        cache_hash_ = &HashKey<Hash>;
+        cache_.reset(new HotCache<ItemT>(capacity));
+    }
+
+    template<typename K, typename V>
+    template<typename Hash>
+    std::uint64_t Tree<K, V>::HashKey(const KeyType& key) {
+        return MixHash(Hash()(key));
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::BloomInsert(const KeyType& key) {
+        // Rebuild before adding, the tree does not have the key yet.
+        if (bloom_->NeedsRebuild()) {
+            RebuildBloomFilter();
+        }
+        bloom_->Add(bloom_hash_(key));
+    }
+
+    template<typename K, typename V>
+    void Tree<K, V>::RebuildBloomFilter() {
+        std::vector<std::uint64_t> hashes;
+        if (root_ != nullptr) {
+            root_->Traverse([this, &hashes](ItemT* item) {
+                hashes.push_back(bloom_hash_(item->key()));
+            });
+        }
+        // Room to double before the next rebuild.
+        std::size_t capacity = std::max<std::size_t>(2 * hashes.size(), 1024);
+        if (bloom_ == nullptr) {
+            bloom_.reset(new BloomFilter(capacity));
+        } else {
+            bloom_->Reset(capacity);
+            bloom_->RecordRebuild();
+        }
+        for (auto hash : hashes) {
+            bloom_->Add(hash);
+        }
     }
 } // namespace BTree
 
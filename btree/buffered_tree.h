@@ -0,0 +1,270 @@
+#ifndef BUFFERED_TREE_H
+#define BUFFERED_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "btree.h"
+
+namespace BTree {
+
+    /* BufferedTree puts write buffers in front of a Tree, like the memtable
+     * and first level of a log-structured merge tree. Deletes are written
+     * as tombstones.
+     *
+     * Writes go into a small sorted array that stays in cache, at the cost
+     * of a binary search and a short move. A full buffer is merged into a
+     * larger sorted run in one linear pass. A full run is frozen and merged
+     * into the tree in key order, kMergeStep entries per later write, so
+     * that no single write pays for the whole merge. The run holds many
+     * keys per leaf of the tree, and inserting them in order with
+     * InsertNear climbs only a level or two from the previous one instead
+     * of descending from the root with a cache miss per level.
+     *
+     * Find and Scan look at the buffer, the run, the frozen run and then
+     * the tree; the newest entry for a key wins. Unlike Tree, every key is
+     * stored once and Put replaces its value.
+     */
+    template<typename K = int, typename V = int>
+    class BufferedTree {
+        public:
+            using ValueType = V;
+            using KeyType = K;
+            using ItemT = Item<K, V>;
+
+            // Entries of the frozen run merged per write. The next run
+            // takes at least run_size writes to fill, so this is enough to
+            // be done by then.
+            static const std::size_t kMergeStep = 2;
+
+            explicit BufferedTree(std::size_t buffer_size = 4096, std::size_t run_size = 1 << 18):
+                buffer_size_(buffer_size), run_size_(std::max(run_size, buffer_size)) {}
+
+            void Put(KeyType key, ValueType value) { Write(key, value, false); }
+            void Delete(KeyType key) { Write(key, ValueType(), true); }
+
+            // Copies the value stored with key, false if there is none.
+            bool Find(KeyType key, ValueType* value);
+            // Visits the keys not smaller than from in order until fn
+            // returns false.
+            void Scan(KeyType from, std::function<bool(const KeyType&, const ValueType&)> fn);
+
+            // Merges everything into the tree right away.
+            void Merge();
+
+            Tree<K, V>& tree() { return tree_; }
+            // Entries not in the tree yet, tombstones included.
+            std::size_t buffered() {
+                return buffer_.size() + run_.size() + frozen_.size() - merged_;
+            }
+            // Runs merged into the tree.
+            std::size_t merges() { return merges_; }
+
+        private:
+            struct Entry {
+                KeyType key;
+                ValueType value;
+                bool deleted;
+            };
+            using Iterator = typename std::vector<Entry>::const_iterator;
+
+            void Write(KeyType key, ValueType value, bool deleted);
+            // Merges the buffer into the run, and the run into the tree
+            // once it is full.
+            void Flush();
+            // Merges up to count entries of the frozen run into the tree.
+            void MergeFrozen(std::size_t count);
+            static Iterator LowerBound(const std::vector<Entry>& entries, const KeyType& key);
+            // Entry for key, or nullptr.
+            static const Entry* Lookup(const std::vector<Entry>& entries, const KeyType& key);
+
+            Tree<K, V> tree_;
+            std::vector<Entry> buffer_;
+            std::vector<Entry> run_;
+            std::vector<Entry> frozen_;
+            // Entries of frozen_ already in the tree, they stay until all of
+            // it is merged so that lookups find them in either place.
+            std::size_t merged_ = 0;
+            std::size_t buffer_size_;
+            std::size_t run_size_;
+            std::size_t merges_ = 0;
+    };
+
+    template<typename K, typename V>
+    const std::size_t BufferedTree<K, V>::kMergeStep;
+
+    template<typename K, typename V>
+    void BufferedTree<K, V>::Write(KeyType key, ValueType value, bool deleted) {
+        if (!frozen_.empty()) {
+            MergeFrozen(kMergeStep);
+        }
+        auto position = buffer_.begin() + (LowerBound(buffer_, key) - buffer_.cbegin());
+        if (position != buffer_.end() && !(key < position->key)) {
+            position->value = value;
+            position->deleted = deleted;
+            return;
+        }
+        buffer_.insert(position, Entry{key, value, deleted});
+        if (buffer_.size() >= buffer_size_) {
+            Flush();
+        }
+    }
+
+    template<typename K, typename V>
+    void BufferedTree<K, V>::Flush() {
+        std::vector<Entry> merged;
+        merged.reserve(run_.size() + buffer_.size());
+        auto older = run_.cbegin();
+        for (const auto& entry : buffer_) {
+            while (older != run_.cend() && older->key < entry.key) {
+                merged.push_back(*older++);
+            }
+            if (older != run_.cend() && !(entry.key < older->key)) {
+                ++older;
+            }
+            merged.push_back(entry);
+        }
+        merged.insert(merged.end(), older, run_.cend());
+        run_.swap(merged);
+        buffer_.clear();
+        if (run_.size() >= run_size_) {
+            // A frozen run left over from the last time is finished
+            // first, there is only room for one.
+            MergeFrozen(frozen_.size());
+            frozen_.swap(run_);
+            run_.clear();
+        }
+    }
+
+    template<typename K, typename V>
+    void BufferedTree<K, V>::MergeFrozen(std::size_t count) {
+        std::size_t end = std::min(frozen_.size(), merged_ + count);
+        for (; merged_ < end; merged_++) {
+            const Entry& entry = frozen_[merged_];
+            if (entry.deleted) {
+                tree_.Delete(entry.key);
+                continue;
+            }
+            ItemT* item = tree_.FindNear(entry.key);
+            if (item != nullptr) {
+                item->SetValue(entry.value);
+            } else {
+                tree_.InsertNear(entry.key, entry.value);
+            }
+        }
+        if (merged_ == frozen_.size() && !frozen_.empty()) {
+            frozen_.clear();
+            merged_ = 0;
+            merges_++;
+        }
+    }
+
+    template<typename K, typename V>
+    void BufferedTree<K, V>::Merge() {
+        if (!buffer_.empty()) {
+            Flush();
+        }
+        MergeFrozen(frozen_.size());
+        frozen_.swap(run_);
+        MergeFrozen(frozen_.size());
+    }
+
+    template<typename K, typename V>
+    typename BufferedTree<K, V>::Iterator BufferedTree<K, V>::LowerBound(
+        const std::vector<Entry>& entries, const KeyType& key) {
+        return std::lower_bound(entries.begin(), entries.end(), key,
+                                [](const Entry& entry, const KeyType& key) {
+                                    return entry.key < key;
+                                });
+    }
+
+    template<typename K, typename V>
+    const typename BufferedTree<K, V>::Entry* BufferedTree<K, V>::Lookup(
+        const std::vector<Entry>& entries, const KeyType& key) {
+        auto it = LowerBound(entries, key);
+        if (it == entries.end() || key < it->key) {
+            return nullptr;
+        }
+        return &*it;
+    }
+
+    template<typename K, typename V>
+    bool BufferedTree<K, V>::Find(KeyType key, ValueType* value) {
+        const Entry* entry = Lookup(buffer_, key);
+        if (entry == nullptr) {
+            entry = Lookup(run_, key);
+        }
+        if (entry == nullptr) {
+            entry = Lookup(frozen_, key);
+        }
+        if (entry != nullptr) {
+            if (entry->deleted) {
+                return false;
+            }
+            *value = entry->value;
+            return true;
+        }
+        ItemT* item = tree_.Find(key);
+        if (item == nullptr) {
+            return false;
+        }
+        *value = item->value();
+        return true;
+    }
+
+    template<typename K, typename V>
+    void BufferedTree<K, V>::Scan(KeyType from,
+                                  std::function<bool(const KeyType&, const ValueType&)> fn) {
+        // Newest first, on equal keys the first one wins.
+        const std::vector<Entry>* layers[] = {&buffer_, &run_, &frozen_};
+        const std::size_t kLayers = 3;
+        Iterator next[kLayers];
+        for (std::size_t i = 0; i < kLayers; i++) {
+            next[i] = LowerBound(*layers[i], from);
+        }
+        bool more = true;
+        // Emits buffered entries up to key, or all of them for nullptr.
+        // Returns whether the buffers hold key itself, which then shadows
+        // the tree's item.
+        auto drain = [&](const KeyType* key) {
+            while (more) {
+                const Entry* entry = nullptr;
+                for (std::size_t i = 0; i < kLayers; i++) {
+                    if (next[i] != layers[i]->end() &&
+                        (entry == nullptr || next[i]->key < entry->key)) {
+                        entry = &*next[i];
+                    }
+                }
+                if (entry == nullptr || (key != nullptr && *key < entry->key)) {
+                    return false;
+                }
+                // Skip the older entries for the same key.
+                KeyType current = entry->key;
+                for (std::size_t i = 0; i < kLayers; i++) {
+                    if (next[i] != layers[i]->end() && !(current < next[i]->key)) {
+                        ++next[i];
+                    }
+                }
+                if (!entry->deleted) {
+                    more = fn(current, entry->value);
+                }
+                if (key != nullptr && !(current < *key)) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        tree_.Scan(from, [&](ItemT* item) {
+            KeyType key = item->key();
+            if (!drain(&key) && more) {
+                more = fn(key, item->value());
+            }
+            return more;
+        });
+        drain(nullptr);
+    }
+} // namespace BTree
+
+#endif // BUFFERED_TREE_H
@@ -0,0 +1,97 @@
+#ifndef FROZEN_H
+#define FROZEN_H
+
+#include <cstddef>
+#include <vector>
+
+namespace BTree {
+
+    /* FrozenTree is an immutable copy of a tree for read-only workloads.
+     * Keys and values live in plain arrays in Eytzinger (breadth first)
+     * order: slot 1 is the root and slot k has children 2k and 2k + 1,
+     * slot 0 is unused. The top of the tree stays in cache, a search is a
+     * branch-free walk down the array and the descendants a few levels
+     * below are prefetched, so there are no pointers to chase.
+     */
+    template<typename K = int, typename V = int>
+    class FrozenTree {
+        public:
+            using ValueType = V;
+            using KeyType = K;
+
+            FrozenTree() : keys_(1), values_(1) {}
+            // keys have to be sorted, values go with the keys.
+            FrozenTree(const std::vector<KeyType>& keys,
+                       const std::vector<ValueType>& values);
+
+            std::size_t size() { return keys_.size() - 1; }
+
+            // Slot of the first key not smaller than key, 0 if there is none.
+            std::size_t LowerBound(KeyType key);
+            // Value stored with key, or nullptr.
+            const ValueType* Find(KeyType key);
+
+            KeyType KeyAt(std::size_t slot) { return keys_[slot]; }
+            ValueType ValueAt(std::size_t slot) { return values_[slot]; }
+
+        private:
+            std::size_t Fill(std::size_t slot, std::size_t position,
+                             const std::vector<KeyType>& keys,
+                             const std::vector<ValueType>& values);
+
+            // Slots in one cache line, prefetching slot k * kBlock fetches
+            // the descendants of k four levels down for 4 byte keys.
+            static const std::size_t kBlock =
+                sizeof(KeyType) < 64 ? 64 / sizeof(KeyType) : 1;
+
+            std::vector<KeyType> keys_;
+            std::vector<ValueType> values_;
+    };
+
+    template<typename K, typename V>
+    FrozenTree<K, V>::FrozenTree(const std::vector<KeyType>& keys,
+                                 const std::vector<ValueType>& values)
+        : keys_(keys.size() + 1), values_(values.size() + 1) {
+        Fill(1, 0, keys, values);
+    }
+
+    template<typename K, typename V>
+    std::size_t FrozenTree<K, V>::Fill(std::size_t slot, std::size_t position,
+                                       const std::vector<KeyType>& keys,
+                                       const std::vector<ValueType>& values) {
+        // In-order walk over the implicit tree hands out sorted positions.
+        if (slot >= keys_.size()) {
+            return position;
+        }
+        position = Fill(2 * slot, position, keys, values);
+        keys_[slot] = keys[position];
+        values_[slot] = values[position];
+        return Fill(2 * slot + 1, position + 1, keys, values);
+    }
+
+    template<typename K, typename V>
+    std::size_t FrozenTree<K, V>::LowerBound(KeyType key) {
+        const KeyType* keys = keys_.data();
+        std::size_t n = keys_.size() - 1;
+        std::size_t k = 1;
+        while (k <= n) {
+            __builtin_prefetch(keys + k * kBlock);
+            k = 2 * k + (keys[k] < key);
+        }
+        // Every right turn appended a one bit, undo them and the last left
+        // turn to get back to the slot where the search went left.
+        k >>= __builtin_ffsl(~k);
+        return k;
+    }
+
+    template<typename K, typename V>
+    const V* FrozenTree<K, V>::Find(KeyType key) {
+        std::size_t slot = LowerBound(key);
+        if (slot == 0 || key < keys_[slot]) {
+            return nullptr;
+        }
+        return &values_[slot];
+    }
+} // namespace BTree
+
+#endif // FROZEN_H
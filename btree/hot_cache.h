@@ -0,0 +1,204 @@
+#ifndef HOT_CACHE_H
+#define HOT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace BTree {
+
+    struct HotCacheStats {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+        // Misses found in the tree that were let into the cache, and the
+        // ones that lost against the entry they would have replaced.
+        std::size_t admissions = 0;
+        std::size_t rejections = 0;
+
+        double HitRate() const {
+            std::size_t lookups = hits + misses;
+            return lookups == 0 ? 0 : static_cast<double>(hits) / lookups;
+        }
+    };
+
+    /* FrequencySketch estimates how often a hash was seen lately. It is a
+     * count-min sketch of 4-bit counters, kDepth of them per hash, and the
+     * estimate is the smallest one. Increments are conservative, only the
+     * counters at the minimum go up, which keeps the counts of rare keys
+     * from being inflated by collisions with hot ones. After a sample of
+     * 10 lookups per counted entry all counters are halved, so that keys
+     * that were hot a while ago fade out.
+     */
+    class FrequencySketch {
+        public:
+            static const std::size_t kDepth = 4;
+            static const std::uint8_t kMaxCount = 15;
+
+            explicit FrequencySketch(std::size_t entries) {
+                std::size_t width = 64;
+                while (width < 16 * entries) {
+                    width *= 2;
+                }
+                counters_.assign(width, 0);
+                sample_size_ = 10 * entries;
+            }
+
+            void Increment(std::uint64_t hash) {
+                std::uint8_t estimate = Estimate(hash);
+                if (estimate < kMaxCount) {
+                    for (std::size_t i = 0; i < kDepth; i++) {
+                        std::uint8_t& counter = counters_[Index(hash, i)];
+                        if (counter == estimate) {
+                            counter++;
+                        }
+                    }
+                }
+                if (++additions_ >= sample_size_) {
+                    Age();
+                }
+            }
+
+            std::uint8_t Estimate(std::uint64_t hash) const {
+                std::uint8_t estimate = kMaxCount;
+                for (std::size_t i = 0; i < kDepth; i++) {
+                    std::uint8_t counter = counters_[Index(hash, i)];
+                    estimate = counter < estimate ? counter : estimate;
+                }
+                return estimate;
+            }
+
+        private:
+            std::size_t Index(std::uint64_t hash, std::size_t i) const {
+                // Double hashing, the step is odd and so never zero.
+                std::uint64_t step = (hash >> 32) | 1;
+                return (hash + i * step) & (counters_.size() - 1);
+            }
+
+            void Age() {
+                for (auto& counter : counters_) {
+                    counter >>= 1;
+                }
+                additions_ = 0;
+            }
+
+            std::vector<std::uint8_t> counters_;
+            std::size_t sample_size_ = 0;
+            std::size_t additions_ = 0;
+    };
+
+    /* HotCache maps hashed keys to items of a tree, in front of a lookup
+     * that would otherwise descend from the root. It is an open addressing
+     * table whose probes stay in a bucket of kWays slots, so a lookup reads
+     * one or two cache lines. Keys are compared through the item, T needs
+     * a key() method; the owner passes the key's hash along.
+     *
+     * Admission follows TinyLFU: every lookup is counted in a frequency
+     * sketch, and a key found in the tree only takes a full bucket's least
+     * frequent slot if it was looked up more often than that slot's key.
+     * Keys read once, like those of a scan, do not push out hot ones.
+     *
+     * The cache holds no values, only pointers to the items, so updated
+     * values are seen right away. The owner erases keys whose items are
+     * freed.
+     */
+    template<typename T>
+    class HotCache {
+        public:
+            static const std::size_t kWays = 4;
+
+            // Room for at least capacity items.
+            explicit HotCache(std::size_t capacity):
+                slots_(((capacity + kWays - 1) / kWays) * kWays),
+                sketch_(slots_.size()) {
+                if (slots_.empty()) {
+                    slots_.resize(kWays);
+                }
+            }
+
+            // The cached item for key, or nullptr.
+            template<typename K>
+            T* Find(const K& key, std::uint64_t hash) {
+                sketch_.Increment(hash);
+                Slot* bucket = Bucket(hash);
+                for (std::size_t i = 0; i < kWays; i++) {
+                    if (bucket[i].item != nullptr && bucket[i].hash == hash &&
+                        bucket[i].item->key() == key) {
+                        stats_.hits++;
+                        return bucket[i].item;
+                    }
+                }
+                stats_.misses++;
+                return nullptr;
+            }
+
+            // Offers an item found after a miss, it goes into a free slot
+            // of its bucket or replaces a less frequent key.
+            void Admit(std::uint64_t hash, T* item) {
+                Slot* bucket = Bucket(hash);
+                Slot* victim = &bucket[0];
+                for (std::size_t i = 0; i < kWays; i++) {
+                    if (bucket[i].item == nullptr) {
+                        victim = &bucket[i];
+                        break;
+                    }
+                    if (sketch_.Estimate(bucket[i].hash) < sketch_.Estimate(victim->hash)) {
+                        victim = &bucket[i];
+                    }
+                }
+                if (victim->item != nullptr &&
+                    sketch_.Estimate(hash) <= sketch_.Estimate(victim->hash)) {
+                    stats_.rejections++;
+                    return;
+                }
+                victim->hash = hash;
+                victim->item = item;
+                stats_.admissions++;
+            }
+
+            template<typename K>
+            void Erase(const K& key, std::uint64_t hash) {
+                Slot* bucket = Bucket(hash);
+                for (std::size_t i = 0; i < kWays; i++) {
+                    if (bucket[i].item != nullptr && bucket[i].hash == hash &&
+                        bucket[i].item->key() == key) {
+                        bucket[i].item = nullptr;
+                    }
+                }
+            }
+
+            // Forgets all items, the frequencies and stats are kept.
+            void Clear() {
+                for (auto& slot : slots_) {
+                    slot.item = nullptr;
+                }
+            }
+
+            std::size_t capacity() const { return slots_.size(); }
+            std::size_t size() const {
+                std::size_t used = 0;
+                for (const auto& slot : slots_) {
+                    used += slot.item != nullptr;
+                }
+                return used;
+            }
+            const HotCacheStats& stats() const { return stats_; }
+
+        private:
+            struct Slot {
+                std::uint64_t hash = 0;
+                T* item = nullptr;
+            };
+
+            Slot* Bucket(std::uint64_t hash) {
+                std::size_t buckets = slots_.size() / kWays;
+                std::size_t bucket = ((hash >> 32) * buckets) >> 32;
+                return &slots_[bucket * kWays];
+            }
+
+            std::vector<Slot> slots_;
+            FrequencySketch sketch_;
+            HotCacheStats stats_;
+    };
+} // namespace BTree
+
+#endif // HOT_CACHE_H
@@ -0,0 +1,158 @@
+#ifndef INTERLEAVED_H
+#define INTERLEAVED_H
+
+// FindInterleaved, lookups of a Tree run as coroutines. Only with C++20,
+// and outside of Tree so that the class is the same in every mode.
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+
+#define BTREE_HAS_COROUTINES 1
+
+namespace BTree {
+
+    /* LookupTask is a coroutine that produces one value. It starts
+     * suspended and is driven by whoever holds it, calling Resume until
+     * Done, which makes it a unit for a round-robin scheduler.
+     */
+    template<typename T>
+    class LookupTask {
+        public:
+            struct promise_type {
+                T value{};
+
+                LookupTask get_return_object() {
+                    return LookupTask(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+                std::suspend_always initial_suspend() noexcept { return {}; }
+                std::suspend_always final_suspend() noexcept { return {}; }
+                void return_value(T result) { value = result; }
+                void unhandled_exception() { std::terminate(); }
+            };
+
+            LookupTask() = default;
+            LookupTask(const LookupTask&) = delete;
+            LookupTask& operator=(const LookupTask&) = delete;
+            LookupTask(LookupTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+            LookupTask& operator=(LookupTask&& other) noexcept {
+                if (this != &other) {
+                    if (handle_) {
+                        handle_.destroy();
+                    }
+                    handle_ = std::exchange(other.handle_, nullptr);
+                }
+                return *this;
+            }
+            ~LookupTask() {
+                if (handle_) {
+                    handle_.destroy();
+                }
+            }
+
+            bool Done() const { return handle_.done(); }
+            void Resume() { handle_.resume(); }
+            T result() const { return handle_.promise().value; }
+
+        private:
+            explicit LookupTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+            std::coroutine_handle<promise_type> handle_ = nullptr;
+    };
+
+    // Awaiting a Prefetch starts loading address into the cache and
+    // suspends, so that other lookups run while the line arrives.
+    struct Prefetch {
+        const void* address;
+
+        bool await_ready() const noexcept {
+            __builtin_prefetch(address);
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<>) const noexcept {}
+        void await_resume() const noexcept {}
+    };
+
+    // The descent of Node::Find from root, suspending before every pointer
+    // it follows.
+    template<typename K, typename V>
+    LookupTask<Item<K, V>*> FindSuspending(Node<K, V>* root, K key) {
+        Node<K, V>* node = root;
+        while (node != nullptr) {
+            co_await Prefetch{node};
+            Item<K, V>* current = node->FirstItem();
+            Node<K, V>* child = nullptr;
+            while (current != nullptr) {
+                co_await Prefetch{current};
+                if (key == current->key()) {
+                    co_return current;
+                }
+                if (key < current->key()) {
+                    child = node->IsLeaf() ? nullptr : current->left();
+                    break;
+                }
+                Item<K, V>* following = current->NextItem();
+                if (following == nullptr && !node->IsLeaf()) {
+                    child = current->right();
+                }
+                current = following;
+            }
+            node = child;
+        }
+        co_return nullptr;
+    }
+
+    /* Tree::Find for every key, group_size lookups at a time. Each lookup
+     * is a coroutine that prefetches the next node or item and suspends,
+     * the group is resumed round robin so that the cache misses of
+     * different lookups overlap. Results are in the order of keys, the
+     * filter and the cache of the tree are not consulted.
+     */
+    template<typename K, typename V>
+    std::vector<Item<K, V>*> FindInterleaved(Tree<K, V>& tree, const std::vector<K>& keys,
+                                             std::size_t group_size = 24) {
+        std::vector<Item<K, V>*> found(keys.size());
+        if (keys.empty()) {
+            return found;
+        }
+        group_size = std::max<std::size_t>(1, std::min(group_size, keys.size()));
+        std::vector<LookupTask<Item<K, V>*>> tasks(group_size);
+        // Index in keys of the lookup each task runs.
+        std::vector<std::size_t> running(group_size);
+        std::size_t next = 0;
+        for (std::size_t slot = 0; slot < group_size; slot++) {
+            running[slot] = next;
+            tasks[slot] = FindSuspending(tree.root(), keys[next++]);
+        }
+        std::size_t active = group_size;
+        while (active > 0) {
+            for (std::size_t slot = 0; slot < group_size; slot++) {
+                if (running[slot] == keys.size()) {
+                    continue;
+                }
+                tasks[slot].Resume();
+                if (!tasks[slot].Done()) {
+                    continue;
+                }
+                found[running[slot]] = tasks[slot].result();
+                if (next < keys.size()) {
+                    running[slot] = next;
+                    tasks[slot] = FindSuspending(tree.root(), keys[next++]);
+                } else {
+                    running[slot] = keys.size();
+                    active--;
+                }
+            }
+        }
+        return found;
+    }
+} // namespace BTree
+
+#endif // C++20 coroutines
+
+#endif // INTERLEAVED_H
@@ -0,0 +1,366 @@
+#ifndef MVCC_H
+#define MVCC_H
+
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+
+namespace BTree {
+
+    using Timestamp = std::uint64_t;
+
+    // One committed value of a key, deleted marks a tombstone.
+    template<typename V>
+    struct Version {
+        Version(V value, Timestamp commit, bool deleted, Version* older):
+            value(value), commit(commit), deleted(deleted), older(older) {}
+
+        V value;
+        Timestamp commit;
+        bool deleted;
+        std::atomic<Version*> older;
+    };
+
+    // Versions of a key, newest first. The chain of an item never changes,
+    // writers swap its head.
+    template<typename V>
+    struct VersionChain {
+        explicit VersionChain(Version<V>* head): head(head) {}
+
+        std::atomic<Version<V>*> head;
+    };
+
+    struct MVCCStats {
+        std::size_t commits = 0;
+        // Versions currently kept, tombstones included.
+        std::size_t versions = 0;
+        std::size_t collections = 0;
+        std::size_t collected_versions = 0;
+        // Keys whose last version was a tombstone nobody could still see.
+        std::size_t removed_keys = 0;
+    };
+
+    /* MVCCTree is a tree whose values are versioned, so that readers see
+     * the tree as of the moment they started while writers go on.
+     *
+     * Every item's value is a VersionChain. A write commits at the next
+     * timestamp of a logical clock: it pushes a new version onto the
+     * chain, or inserts a new item for a new key, and only then advances
+     * the clock. A ReadTransaction reads the clock once and from then on
+     * takes, for each key, the newest version committed at or before
+     * that timestamp, found by walking the atomic chain. So a transaction
+     * reads the same values however long it runs and whatever is written
+     * meanwhile.
+     *
+     * Writers are serialized by a mutex and never wait for readers to
+     * finish. Changes to the tree structure, inserting a new key or
+     * removing a dead one, take a reader-writer lock that readers hold
+     * only for the span of a single Find, never for a whole transaction.
+     * Updating and deleting existing keys does not touch the structure.
+     *
+     * Versions that no active reader can see any more are trimmed by
+     * Collect, from a background thread once StartCollector was called.
+     * A version stays until every transaction that could see it has
+     * ended, so the values Find returns stay valid for the life of the
+     * transaction.
+     */
+    template<typename K = int, typename V = int>
+    class MVCCTree {
+        public:
+            using ValueType = V;
+            using KeyType = K;
+            using VersionT = Version<V>;
+            using ChainT = VersionChain<V>;
+
+            class ReadTransaction {
+                public:
+                    ReadTransaction(const ReadTransaction&) = delete;
+                    ReadTransaction& operator=(const ReadTransaction&) = delete;
+                    ReadTransaction(ReadTransaction&& other):
+                        tree_(other.tree_), timestamp_(other.timestamp_) {
+                        other.tree_ = nullptr;
+                    }
+                    ~ReadTransaction() {
+                        if (tree_ != nullptr) {
+                            tree_->EndRead(timestamp_);
+                        }
+                    }
+
+                    Timestamp timestamp() const { return timestamp_; }
+                    // Value of key as of timestamp(), or nullptr.
+                    const ValueType* Find(KeyType key) const {
+                        return tree_->FindAt(key, timestamp_);
+                    }
+
+                private:
+                    friend class MVCCTree;
+                    ReadTransaction(MVCCTree* tree, Timestamp timestamp):
+                        tree_(tree), timestamp_(timestamp) {}
+
+                    MVCCTree* tree_;
+                    Timestamp timestamp_;
+            };
+
+            MVCCTree() { pthread_rwlock_init(&structure_, nullptr); }
+            MVCCTree(const MVCCTree&) = delete;
+            MVCCTree& operator=(const MVCCTree&) = delete;
+            ~MVCCTree();
+
+            // Starts a transaction reading the last committed state. Reads
+            // only go through transactions, the collector does not know
+            // about any other readers.
+            ReadTransaction BeginRead();
+
+            // Each write commits on its own and returns its timestamp,
+            // Delete returns 0 if there was nothing to delete.
+            Timestamp Put(KeyType key, ValueType value);
+            Timestamp Delete(KeyType key);
+
+            // Trims the versions no active transaction can see and removes
+            // keys that are deleted for all of them. Returns the number of
+            // versions freed.
+            std::size_t Collect();
+            // Runs Collect every period on a background thread until
+            // StopCollector or destruction.
+            void StartCollector(std::chrono::milliseconds period);
+            void StopCollector();
+
+            // Timestamp of the last commit.
+            Timestamp clock() const { return clock_.load(); }
+            MVCCStats stats();
+
+        private:
+            struct ReadGuard {
+                explicit ReadGuard(pthread_rwlock_t* lock): lock(lock) { pthread_rwlock_rdlock(lock); }
+                ~ReadGuard() { pthread_rwlock_unlock(lock); }
+                pthread_rwlock_t* lock;
+            };
+            struct WriteGuard {
+                explicit WriteGuard(pthread_rwlock_t* lock): lock(lock) { pthread_rwlock_wrlock(lock); }
+                ~WriteGuard() { pthread_rwlock_unlock(lock); }
+                pthread_rwlock_t* lock;
+            };
+
+            const ValueType* FindAt(KeyType key, Timestamp timestamp);
+            void EndRead(Timestamp timestamp);
+            // Timestamp no active reader is older than.
+            Timestamp Horizon();
+            // Frees version and all older ones, returns how many.
+            static std::size_t FreeVersions(VersionT* version);
+
+            Tree<K, ChainT*> tree_;
+            std::atomic<Timestamp> clock_{0};
+            // Held by writers and the collector, one at a time.
+            std::mutex writer_mutex_;
+            // Shared by readers during a Find, exclusive while keys are
+            // inserted into or removed from tree_.
+            pthread_rwlock_t structure_;
+            // Timestamps of the active transactions.
+            std::mutex readers_mutex_;
+            std::multiset<Timestamp> readers_;
+            MVCCStats stats_;
+
+            std::thread collector_;
+            std::mutex collector_mutex_;
+            std::condition_variable collector_wakeup_;
+            bool stop_collector_ = false;
+    };
+
+    template<typename K, typename V>
+    MVCCTree<K, V>::~MVCCTree() {
+        StopCollector();
+        if (tree_.root() != nullptr) {
+            tree_.root()->Traverse([](Item<K, ChainT*>* item) {
+                FreeVersions(item->value()->head.load());
+                delete item->value();
+            });
+        }
+        pthread_rwlock_destroy(&structure_);
+    }
+
+    template<typename K, typename V>
+    typename MVCCTree<K, V>::ReadTransaction MVCCTree<K, V>::BeginRead() {
+        // Under the mutex, so that Horizon either sees this reader or was
+        // taken before its timestamp.
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        Timestamp timestamp = clock_.load(std::memory_order_acquire);
+        readers_.insert(timestamp);
+        return ReadTransaction(this, timestamp);
+    }
+
+    template<typename K, typename V>
+    void MVCCTree<K, V>::EndRead(Timestamp timestamp) {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        readers_.erase(readers_.find(timestamp));
+    }
+
+    template<typename K, typename V>
+    Timestamp MVCCTree<K, V>::Horizon() {
+        std::lock_guard<std::mutex> lock(readers_mutex_);
+        if (readers_.empty()) {
+            return clock_.load(std::memory_order_acquire);
+        }
+        return *readers_.begin();
+    }
+
+    template<typename K, typename V>
+    const V* MVCCTree<K, V>::FindAt(KeyType key, Timestamp timestamp) {
+        // The chain is walked under the lock as well, a key whose only
+        // version is an old tombstone may be removed right after.
+        ReadGuard guard(&structure_);
+        Item<K, ChainT*>* item = tree_.Find(key);
+        if (item == nullptr) {
+            return nullptr;
+        }
+        VersionT* version = item->value()->head.load(std::memory_order_acquire);
+        while (version != nullptr && version->commit > timestamp) {
+            version = version->older.load(std::memory_order_acquire);
+        }
+        if (version == nullptr || version->deleted) {
+            return nullptr;
+        }
+        return &version->value;
+    }
+
+    template<typename K, typename V>
+    Timestamp MVCCTree<K, V>::Put(KeyType key, ValueType value) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        Timestamp commit = clock_.load(std::memory_order_relaxed) + 1;
+        Item<K, ChainT*>* item = tree_.Find(key);
+        if (item != nullptr) {
+            ChainT* chain = item->value();
+            VersionT* head = chain->head.load(std::memory_order_relaxed);
+            chain->head.store(new VersionT(value, commit, false, head),
+                              std::memory_order_release);
+        } else {
+            ChainT* chain = new ChainT(new VersionT(value, commit, false, nullptr));
+            WriteGuard guard(&structure_);
+            tree_.Insert(key, chain);
+        }
+        // Readers starting from here on see the new version.
+        clock_.store(commit, std::memory_order_release);
+        stats_.commits++;
+        stats_.versions++;
+        return commit;
+    }
+
+    template<typename K, typename V>
+    Timestamp MVCCTree<K, V>::Delete(KeyType key) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        Item<K, ChainT*>* item = tree_.Find(key);
+        if (item == nullptr) {
+            return 0;
+        }
+        ChainT* chain = item->value();
+        VersionT* head = chain->head.load(std::memory_order_relaxed);
+        if (head->deleted) {
+            return 0;
+        }
+        Timestamp commit = clock_.load(std::memory_order_relaxed) + 1;
+        chain->head.store(new VersionT(head->value, commit, true, head),
+                          std::memory_order_release);
+        clock_.store(commit, std::memory_order_release);
+        stats_.commits++;
+        stats_.versions++;
+        return commit;
+    }
+
+    template<typename K, typename V>
+    std::size_t MVCCTree<K, V>::Collect() {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        Timestamp horizon = Horizon();
+        std::size_t freed = 0;
+        std::vector<std::pair<K, ChainT*>> dead;
+        if (tree_.root() != nullptr) {
+            tree_.root()->Traverse([horizon, &freed, &dead](Item<K, ChainT*>* item) {
+                // Every reader sees this version or a newer one, the older
+                // ones can go.
+                ChainT* chain = item->value();
+                VersionT* head = chain->head.load(std::memory_order_relaxed);
+                VersionT* visible = head;
+                while (visible != nullptr && visible->commit > horizon) {
+                    visible = visible->older.load(std::memory_order_relaxed);
+                }
+                if (visible == nullptr) {
+                    return;
+                }
+                freed += FreeVersions(visible->older.exchange(nullptr));
+                if (visible == head && visible->deleted) {
+                    dead.push_back({item->key(), chain});
+                }
+            });
+        }
+        if (!dead.empty()) {
+            WriteGuard guard(&structure_);
+            for (auto& key_chain : dead) {
+                tree_.Delete(key_chain.first);
+            }
+        }
+        for (auto& key_chain : dead) {
+            freed += FreeVersions(key_chain.second->head.load());
+            delete key_chain.second;
+        }
+        stats_.collections++;
+        stats_.collected_versions += freed;
+        stats_.versions -= freed;
+        stats_.removed_keys += dead.size();
+        return freed;
+    }
+
+    template<typename K, typename V>
+    std::size_t MVCCTree<K, V>::FreeVersions(VersionT* version) {
+        std::size_t freed = 0;
+        while (version != nullptr) {
+            VersionT* older = version->older.load(std::memory_order_relaxed);
+            delete version;
+            version = older;
+            freed++;
+        }
+        return freed;
+    }
+
+    template<typename K, typename V>
+    void MVCCTree<K, V>::StartCollector(std::chrono::milliseconds period) {
+        StopCollector();
+        stop_collector_ = false;
+        collector_ = std::thread([this, period]() {
+            std::unique_lock<std::mutex> lock(collector_mutex_);
+            while (!collector_wakeup_.wait_for(lock, period, [this]() { return stop_collector_; })) {
+                lock.unlock();
+                Collect();
+                lock.lock();
+            }
+        });
+    }
+
+    template<typename K, typename V>
+    void MVCCTree<K, V>::StopCollector() {
+        if (!collector_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(collector_mutex_);
+            stop_collector_ = true;
+        }
+        collector_wakeup_.notify_all();
+        collector_.join();
+    }
+
+    template<typename K, typename V>
+    MVCCStats MVCCTree<K, V>::stats() {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        return stats_;
+    }
+} // namespace BTree
+
+#endif // MVCC_H
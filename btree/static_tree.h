@@ -0,0 +1,171 @@
+#ifndef STATIC_TREE_H
+#define STATIC_TREE_H
+
+#include <cstddef>
+#include <type_traits>
+
+namespace BTree {
+
+    // Compile-time list of indices, for expanding arrays element by element.
+    template<std::size_t... Is>
+    struct IndexSequence {};
+
+    template<typename Low, typename High>
+    struct ConcatIndices;
+
+    template<std::size_t... Low, std::size_t... High>
+    struct ConcatIndices<IndexSequence<Low...>, IndexSequence<High...>> {
+        using Type = IndexSequence<Low..., (sizeof...(Low) + High)...>;
+    };
+
+    // IndexSequence<0, ..., N - 1>, built by halving so that the template
+    // depth stays logarithmic.
+    template<std::size_t N>
+    struct MakeIndexSequence {
+        using Type = typename ConcatIndices<typename MakeIndexSequence<N / 2>::Type,
+                                            typename MakeIndexSequence<N - N / 2>::Type>::Type;
+    };
+
+    template<>
+    struct MakeIndexSequence<0> {
+        using Type = IndexSequence<>;
+    };
+
+    template<>
+    struct MakeIndexSequence<1> {
+        using Type = IndexSequence<0>;
+    };
+
+    constexpr std::size_t FloorLog2(std::size_t n) {
+        return n < 2 ? 0 : 1 + FloorLog2(n / 2);
+    }
+
+    // Key and value of a StaticTree, read like those of an Item.
+    template<typename K, typename V>
+    class StaticEntry {
+        public:
+            constexpr StaticEntry(K key, V value) : key_(key), value_(value) {}
+
+            constexpr K key() const { return key_; }
+            constexpr V value() const { return value_; }
+
+        private:
+            K key_;
+            V value_;
+    };
+
+    /* StaticTree is a search structure over N entries fixed at compile
+     * time, for small tables like configuration maps. It is laid out like
+     * a FrozenTree, in Eytzinger order in a plain array, but the array is
+     * filled by a constexpr constructor and the number of levels is a
+     * constant: a search is kDepth branch-free steps without a loop, and a
+     * constexpr tree needs no construction at run time.
+     *
+     * The last level is padded to a full one with copies of an entry, a
+     * search treats padding slots as smaller than any key. K and V have to
+     * be literal types for the tree to be built at compile time.
+     *
+     *     constexpr auto kTable = BTree::MakeStaticTree<int, int>({{1, 10}, {4, 40}});
+     *     static_assert(kTable.Find(4)->value() == 40, "");
+     */
+    template<typename K, typename V, std::size_t N>
+    class StaticTree {
+        static_assert(N > 0, "a StaticTree needs at least one entry");
+
+        public:
+            using ValueType = V;
+            using KeyType = K;
+            using EntryT = StaticEntry<K, V>;
+
+            // Levels of the implicit tree, the last one may be partial.
+            static const std::size_t kDepth = FloorLog2(N) + 1;
+            // Slot 0 is unused, slot k has children 2k and 2k + 1.
+            static const std::size_t kSlots = std::size_t(1) << kDepth;
+
+            // sorted has to be sorted by key, see IsSorted.
+            constexpr explicit StaticTree(const EntryT (&sorted)[N])
+                : StaticTree(sorted, typename MakeIndexSequence<kSlots>::Type()) {}
+
+            constexpr std::size_t size() const { return N; }
+
+            // Slot of the first key not smaller than key, 0 if there is none.
+            constexpr std::size_t LowerBound(const KeyType& key) const {
+                return Settle(Descend(key, 1, std::integral_constant<std::size_t, kDepth>()));
+            }
+            // Entry with key, or nullptr.
+            constexpr const EntryT* Find(const KeyType& key) const {
+                return Match(key, LowerBound(key));
+            }
+
+            constexpr const EntryT& At(std::size_t slot) const { return slots_[slot]; }
+
+        private:
+            template<std::size_t... Slots>
+            constexpr StaticTree(const EntryT (&sorted)[N], IndexSequence<Slots...>)
+                : slots_{sorted[Position(Slots)]...} {}
+
+            // One step down per level, unrolled by the overloads.
+            template<std::size_t Steps>
+            constexpr std::size_t Descend(const KeyType& key, std::size_t k,
+                                          std::integral_constant<std::size_t, Steps>) const {
+                return Descend(key, 2 * k + ((k > N) | (slots_[k].key() < key)),
+                               std::integral_constant<std::size_t, Steps - 1>());
+            }
+            constexpr std::size_t Descend(const KeyType&, std::size_t k,
+                                          std::integral_constant<std::size_t, 0>) const {
+                return k;
+            }
+
+            // Every right turn appended a one bit, undo them and the last
+            // left turn to get back to the slot where the search went left.
+            static constexpr std::size_t Settle(std::size_t k) {
+                return k >> __builtin_ffsl(~k);
+            }
+
+            constexpr const EntryT* Match(const KeyType& key, std::size_t slot) const {
+                return slot == 0 || key < slots_[slot].key() ? nullptr : &slots_[slot];
+            }
+
+            // Slots in the subtree of slot k that exist, level by level.
+            static constexpr std::size_t Size(std::size_t first, std::size_t width = 1) {
+                return first > N ? 0 :
+                    (N - first + 1 < width ? N - first + 1 : width) + Size(2 * first, 2 * width);
+            }
+            // Entries that come before the subtree of slot k in key order.
+            static constexpr std::size_t Before(std::size_t k) {
+                return k == 1 ? 0 :
+                    k % 2 == 0 ? Before(k / 2) : Before(k / 2) + Size(k - 1) + 1;
+            }
+            // Position in sorted of the entry for slot k.
+            static constexpr std::size_t Position(std::size_t k) {
+                return k == 0 || k > N ? N - 1 : Before(k) + Size(2 * k);
+            }
+
+            EntryT slots_[kSlots];
+    };
+
+    template<typename K, typename V, std::size_t N>
+    const std::size_t StaticTree<K, V, N>::kDepth;
+
+    template<typename K, typename V, std::size_t N>
+    const std::size_t StaticTree<K, V, N>::kSlots;
+
+    // Builds a StaticTree from a braced list of {key, value} pairs sorted by
+    // key, the number of entries is deduced.
+    template<typename K, typename V, std::size_t N>
+    constexpr StaticTree<K, V, N> MakeStaticTree(const StaticEntry<K, V> (&sorted)[N]) {
+        return StaticTree<K, V, N>(sorted);
+    }
+
+    template<typename K, typename V, std::size_t N>
+    constexpr bool IsSorted(const StaticEntry<K, V> (&entries)[N],
+                            std::size_t begin = 0, std::size_t end = N) {
+        // Halves on each side, so the recursion stays shallow.
+        return end - begin < 2 ||
+            (IsSorted(entries, begin, (begin + end) / 2) &&
+             IsSorted(entries, (begin + end) / 2, end) &&
+             !(entries[(begin + end) / 2].key() < entries[(begin + end) / 2 - 1].key()));
+    }
+} // namespace BTree
+
+#endif // STATIC_TREE_H
@@ -0,0 +1,115 @@
+#include "extent.h"
+
+#include <algorithm>
+
+namespace FS {
+
+void ExtentTree::Map(BlockNumber logical, BlockNumber physical, BlockNumber length) {
+    if (length == 0) {
+        return;
+    }
+    Unmap(logical, length);
+    Extent extent;
+    extent.logical = logical;
+    extent.physical = physical;
+    extent.length = length;
+
+    // Swallow the following extent if this one runs into it.
+    auto next = extents_.Find(extent.end());
+    if (next != nullptr && next->value().physical == physical + length) {
+        BlockNumber next_logical = next->key();
+        extent.length += next->value().length;
+        extents_.Delete(next_logical);
+        size_--;
+    }
+    // And grow the previous one instead of adding an entry if possible.
+    if (logical > 0) {
+        auto previous = extents_.Floor(logical - 1);
+        if (previous != nullptr) {
+            Extent before = previous->value();
+            if (before.end() == logical && before.physical + before.length == physical) {
+                before.length += extent.length;
+                previous->SetValue(before);
+                return;
+            }
+        }
+    }
+    extents_.Insert(logical, extent);
+    size_++;
+}
+
+std::vector<Extent> ExtentTree::Unmap(BlockNumber logical, BlockNumber length) {
+    std::vector<Extent> removed;
+    BlockNumber end = logical + length;
+    if (length == 0) {
+        return removed;
+    }
+
+    // Extents overlapping the range, the first one may start before it.
+    std::vector<Extent> overlapping;
+    auto first = extents_.Floor(logical);
+    BlockNumber from = first != nullptr && first->value().end() > logical ?
+        first->key() : logical;
+    extents_.Scan(from, [end, &overlapping](BTree::Item<BlockNumber, Extent>* item) {
+        if (item->key() >= end) {
+            return false;
+        }
+        overlapping.push_back(item->value());
+        return true;
+    });
+
+    for (const auto& extent : overlapping) {
+        extents_.Delete(extent.logical);
+        size_--;
+        // Keep the parts sticking out on either side.
+        if (extent.logical < logical) {
+            Extent head = extent;
+            head.length = logical - extent.logical;
+            extents_.Insert(head.logical, head);
+            size_++;
+        }
+        if (extent.end() > end) {
+            Extent tail = extent;
+            tail.logical = end;
+            tail.physical = extent.physical + (end - extent.logical);
+            tail.length = extent.end() - end;
+            extents_.Insert(tail.logical, tail);
+            size_++;
+        }
+        Extent cut;
+        cut.logical = std::max(extent.logical, logical);
+        cut.physical = extent.physical + (cut.logical - extent.logical);
+        cut.length = std::min(extent.end(), end) - cut.logical;
+        removed.push_back(cut);
+    }
+    return removed;
+}
+
+bool ExtentTree::Lookup(BlockNumber logical, BlockNumber* physical) {
+    Extent extent;
+    if (!Find(logical, &extent)) {
+        return false;
+    }
+    *physical = extent.physical + (logical - extent.logical);
+    return true;
+}
+
+bool ExtentTree::Find(BlockNumber logical, Extent* extent) {
+    auto item = extents_.Floor(logical);
+    if (item == nullptr || item->value().end() <= logical) {
+        return false;
+    }
+    *extent = item->value();
+    return true;
+}
+
+std::vector<Extent> ExtentTree::Extents() {
+    std::vector<Extent> all;
+    extents_.Scan(0, [&all](BTree::Item<BlockNumber, Extent>* item) {
+        all.push_back(item->value());
+        return true;
+    });
+    return all;
+}
+
+} // namespace FS
@@ -0,0 +1,52 @@
+#ifndef EXTENT_H
+#define EXTENT_H
+
+#include <cstdint>
+#include <vector>
+
+#include "btree.h"
+
+namespace FS {
+
+    using BlockNumber = std::uint64_t;
+
+    // length blocks starting at logical map to the ones starting at physical.
+    struct Extent {
+        BlockNumber logical = 0;
+        BlockNumber physical = 0;
+        BlockNumber length = 0;
+
+        BlockNumber end() const { return logical + length; }
+    };
+
+    /* ExtentTree maps the logical blocks of one file to physical blocks of
+     * the image. Entries are extents keyed by their logical start, a lookup
+     * is a floor search for the extent starting at or before the block.
+     * Extents that continue each other both logically and physically are
+     * merged when mapped, so a file written sequentially stays a handful of
+     * entries no matter how many blocks it has.
+     */
+    class ExtentTree {
+        public:
+            // Maps the range, replacing whatever was mapped there before.
+            void Map(BlockNumber logical, BlockNumber physical, BlockNumber length);
+            // Unmaps the range and returns the physical extents that were
+            // mapped in it, so that the caller can free them.
+            std::vector<Extent> Unmap(BlockNumber logical, BlockNumber length);
+
+            // Physical block behind logical, false for holes.
+            bool Lookup(BlockNumber logical, BlockNumber* physical);
+            // Extent covering logical, false for holes.
+            bool Find(BlockNumber logical, Extent* extent);
+
+            // All extents in logical order.
+            std::vector<Extent> Extents();
+            std::size_t size() { return size_; }
+
+        private:
+            BTree::Tree<BlockNumber, Extent> extents_;
+            std::size_t size_ = 0;
+    };
+} // namespace FS
+
+#endif // EXTENT_H
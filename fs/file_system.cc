@@ -0,0 +1,477 @@
+#include "file_system.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace FS {
+
+const std::size_t FileSystem::kPageSize;
+const std::size_t FileSystem::kMinReadahead;
+const std::size_t FileSystem::kMaxReadahead;
+const std::size_t FileSystem::kMaxWriteBack;
+const unsigned FileSystem::kQueueDepth;
+const BlockNumber FileSystem::kInitialBlocks;
+const int FileSystem::kCreate;
+
+FileSystem::FileSystem(const std::string& image, std::size_t cache_pages, bool async_io)
+    : image_fd_(::open(image.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)),
+      cache_(std::max(cache_pages, 2 * kMaxReadahead), kPageSize),
+      free_space_(kInitialBlocks) {
+    if (async_io) {
+        backend_ = IOBackend::Create(image_fd_, kQueueDepth);
+    } else {
+        backend_.reset(new SyncBackend(image_fd_));
+    }
+}
+
+FileSystem::~FileSystem() {
+    if (image_fd_ >= 0) {
+        Sync();
+        ::close(image_fd_);
+    }
+}
+
+int FileSystem::Open(const std::string& path, int flags) {
+    InodeNumber number = metadata_.Resolve(path);
+    if (number == kNoInode && (flags & kCreate)) {
+        InodeNumber parent;
+        std::string name;
+        if (SplitPath(path, &parent, &name)) {
+            number = metadata_.Create(parent, name, FileType::kFile);
+        }
+    }
+    Inode inode;
+    if (number == kNoInode || !metadata_.GetInode(number, &inode) ||
+        inode.type != FileType::kFile) {
+        return -1;
+    }
+    OpenFile file;
+    file.inode = number;
+    for (std::size_t fd = 0; fd < files_.size(); fd++) {
+        if (files_[fd].inode == kNoInode) {
+            files_[fd] = file;
+            return fd;
+        }
+    }
+    files_.push_back(file);
+    return files_.size() - 1;
+}
+
+bool FileSystem::Close(int fd) {
+    OpenFile* file = GetFile(fd);
+    if (file == nullptr) {
+        return false;
+    }
+    file->inode = kNoInode;
+    return true;
+}
+
+bool FileSystem::Mkdir(const std::string& path) {
+    InodeNumber parent;
+    std::string name;
+    return SplitPath(path, &parent, &name) &&
+           metadata_.Create(parent, name, FileType::kDirectory) != kNoInode;
+}
+
+long FileSystem::Pread(int fd, void* buf, std::size_t count, std::uint64_t offset) {
+    OpenFile* file = GetFile(fd);
+    Inode inode;
+    if (file == nullptr || !metadata_.GetInode(file->inode, &inode)) {
+        return -1;
+    }
+
+    // Sequential reads grow the readahead window, anything else drops it.
+    if (offset == file->next_offset) {
+        file->window = file->window == 0 ? kMinReadahead
+                                         : std::min(2 * file->window, kMaxReadahead);
+    } else {
+        file->window = 0;
+    }
+    long done = ReadPages(file->inode, inode.size, buf, count, offset, file->window);
+    file->next_offset = offset + std::max(done, 0L);
+    return done;
+}
+
+bool FileSystem::ReadMany(int fd, std::vector<ReadRequest>& requests) {
+    OpenFile* file = GetFile(fd);
+    Inode inode;
+    if (file == nullptr || !metadata_.GetInode(file->inode, &inode)) {
+        return false;
+    }
+    // Take the requests in groups that touch at most half the cache, so
+    // that reading the missing pages of a group never evicts pages of the
+    // same group before they are copied out. Holes are left to the copy.
+    ExtentTree& extents = extents_[file->inode];
+    std::size_t budget = cache_.capacity() / 2;
+    bool ok = true;
+    std::size_t next = 0;
+    while (next < requests.size()) {
+        std::vector<BlockNumber> missing;
+        std::size_t touched = 0;
+        std::size_t last = next;
+        for (; last < requests.size(); last++) {
+            const ReadRequest& request = requests[last];
+            BlockNumber first = request.offset / kPageSize;
+            BlockNumber end = first;
+            if (request.offset < inode.size && request.count > 0) {
+                end = (std::min<std::uint64_t>(request.offset + request.count, inode.size) - 1) /
+                      kPageSize + 1;
+            }
+            if (last > next && touched + (end - first) > budget) {
+                break;
+            }
+            touched += end - first;
+            for (BlockNumber index = first; index < end; index++) {
+                if (!cache_.Touch({file->inode, index})) {
+                    missing.push_back(index);
+                }
+            }
+        }
+        std::sort(missing.begin(), missing.end());
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+        missing.resize(std::min(missing.size(), budget));
+
+        std::vector<IORequest> batch;
+        std::vector<std::vector<Page*>> pages;
+        std::size_t i = 0;
+        while (i < missing.size()) {
+            Extent extent;
+            if (!extents.Find(missing[i], &extent)) {
+                i++;
+                continue;
+            }
+            std::size_t j = i + 1;
+            while (j < missing.size() && missing[j] == missing[i] + (j - i) &&
+                   missing[j] < extent.end()) {
+                j++;
+            }
+            batch.emplace_back();
+            pages.emplace_back();
+            PrepareRead(file->inode, extent, missing[i], missing[j - 1] + 1, &pages.back(),
+                        &batch.back());
+            i = j;
+        }
+        backend_->Submit(batch);
+        device_reads_ += batch.size();
+        for (std::size_t k = 0; k < batch.size(); k++) {
+            FinishRead(batch[k], pages[k]);
+        }
+
+        for (; next < last; next++) {
+            ReadRequest& request = requests[next];
+            request.result = ReadPages(file->inode, inode.size, request.buf, request.count,
+                                       request.offset, 0);
+            ok = ok && request.result >= 0;
+        }
+    }
+    return ok;
+}
+
+long FileSystem::ReadPages(InodeNumber inode, std::uint64_t size, void* buf,
+                           std::size_t count, std::uint64_t offset, std::size_t window) {
+    if (offset >= size || count == 0) {
+        return 0;
+    }
+    count = std::min<std::uint64_t>(count, size - offset);
+    BlockNumber last = (offset + count - 1) / kPageSize;
+    BlockNumber limit = std::min<BlockNumber>(last + window, (size - 1) / kPageSize);
+
+    char* out = static_cast<char*>(buf);
+    std::uint64_t position = offset;
+    std::uint64_t end = offset + count;
+    while (position < end) {
+        BlockNumber index = position / kPageSize;
+        std::size_t in_page = position % kPageSize;
+        std::size_t n = std::min<std::uint64_t>(kPageSize - in_page, end - position);
+        Page* page = cache_.Find({inode, index});
+        if (page == nullptr) {
+            page = Fill(inode, index, limit);
+        }
+        if (page == nullptr) {
+            break;
+        }
+        std::memcpy(out, page->data.data() + in_page, n);
+        out += n;
+        position += n;
+    }
+    if (position == offset) {
+        return -1;
+    }
+    return position - offset;
+}
+
+long FileSystem::Pwrite(int fd, const void* buf, std::size_t count, std::uint64_t offset) {
+    OpenFile* file = GetFile(fd);
+    Inode inode;
+    if (file == nullptr || !metadata_.GetInode(file->inode, &inode)) {
+        return -1;
+    }
+    const char* in = static_cast<const char*>(buf);
+    std::uint64_t position = offset;
+    std::uint64_t end = offset + count;
+    while (position < end) {
+        BlockNumber index = position / kPageSize;
+        std::size_t in_page = position % kPageSize;
+        std::size_t n = std::min<std::uint64_t>(kPageSize - in_page, end - position);
+        Page* page = cache_.Find({file->inode, index});
+        if (page == nullptr) {
+            // Partial writes over existing data need the rest of the page.
+            if (n < kPageSize && index * kPageSize < inode.size) {
+                page = Fill(file->inode, index, index);
+            } else if (MakeRoom()) {
+                page = cache_.Add({file->inode, index});
+            }
+        }
+        if (page == nullptr) {
+            break;
+        }
+        std::memcpy(page->data.data() + in_page, in, n);
+        cache_.MarkDirty(page);
+        in += n;
+        position += n;
+    }
+    if (position > inode.size) {
+        metadata_.SetSize(file->inode, position);
+    }
+    // Start writing back before eviction has to do it a page at a time.
+    if (cache_.dirty() > cache_.capacity() / 2) {
+        WriteBack(cache_.DirtyPages());
+    }
+    if (position == offset && count > 0) {
+        return -1;
+    }
+    return position - offset;
+}
+
+bool FileSystem::Fsync(int fd) {
+    OpenFile* file = GetFile(fd);
+    if (file == nullptr) {
+        return false;
+    }
+    return WriteBack(cache_.DirtyPages(file->inode), true);
+}
+
+bool FileSystem::Sync() {
+    return WriteBack(cache_.DirtyPages(), true);
+}
+
+bool FileSystem::Unlink(const std::string& path) {
+    InodeNumber parent;
+    std::string name;
+    if (!SplitPath(path, &parent, &name)) {
+        return false;
+    }
+    InodeNumber number = metadata_.Lookup(parent, name);
+    if (number == kNoInode || !metadata_.Unlink(parent, name)) {
+        return false;
+    }
+    Inode inode;
+    if (metadata_.GetInode(number, &inode)) {
+        return true;
+    }
+    cache_.Drop(number);
+    auto extents = extents_.find(number);
+    if (extents != extents_.end()) {
+        for (const auto& extent : extents->second.Extents()) {
+            free_space_.Free(extent.physical, extent.length);
+        }
+        extents_.erase(extents);
+    }
+    for (auto& file : files_) {
+        if (file.inode == number) {
+            file.inode = kNoInode;
+        }
+    }
+    return true;
+}
+
+ExtentTree* FileSystem::Extents(int fd) {
+    OpenFile* file = GetFile(fd);
+    if (file == nullptr) {
+        return nullptr;
+    }
+    return &extents_[file->inode];
+}
+
+FileSystem::OpenFile* FileSystem::GetFile(int fd) {
+    if (fd < 0 || static_cast<std::size_t>(fd) >= files_.size() ||
+        files_[fd].inode == kNoInode) {
+        return nullptr;
+    }
+    return &files_[fd];
+}
+
+bool FileSystem::SplitPath(const std::string& path, InodeNumber* parent,
+                           std::string* name) {
+    std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos) {
+        return false;
+    }
+    *parent = metadata_.Resolve(slash == 0 ? "/" : path.substr(0, slash));
+    *name = path.substr(slash + 1);
+    return *parent != kNoInode && !name->empty();
+}
+
+Page* FileSystem::Fill(InodeNumber inode, BlockNumber index, BlockNumber limit) {
+    Extent extent;
+    if (!extents_[inode].Find(index, &extent)) {
+        // Holes read as zeros.
+        if (!MakeRoom()) {
+            return nullptr;
+        }
+        return cache_.Add({inode, index});
+    }
+    // Stop at the end of the extent and before the run could push its own
+    // pages out.
+    BlockNumber end = std::min(limit + 1, extent.end());
+    end = std::min<BlockNumber>(end, index + cache_.capacity() / 2);
+    std::vector<IORequest> batch(1);
+    std::vector<Page*> pages;
+    PrepareRead(inode, extent, index, end, &pages, &batch[0]);
+    if (pages.empty()) {
+        return nullptr;
+    }
+    backend_->Submit(batch);
+    device_reads_++;
+    if (!FinishRead(batch[0], pages)) {
+        return nullptr;
+    }
+    return pages[0];
+}
+
+void FileSystem::PrepareRead(InodeNumber inode, const Extent& extent, BlockNumber index,
+                             BlockNumber end, std::vector<Page*>* pages,
+                             IORequest* request) {
+    for (BlockNumber next = index; next < end; next++) {
+        if (next > index && cache_.Contains({inode, next})) {
+            break;
+        }
+        if (!MakeRoom()) {
+            break;
+        }
+        Page* page = cache_.Add({inode, next});
+        pages->push_back(page);
+        request->iov.push_back({page->data.data(), kPageSize});
+    }
+    request->op = IORequest::Op::kRead;
+    request->offset = (extent.physical + (index - extent.logical)) * kPageSize;
+}
+
+bool FileSystem::FinishRead(const IORequest& request, const std::vector<Page*>& pages) {
+    // Short reads leave the rest of the pages zeroed.
+    if (request.result >= 0) {
+        return true;
+    }
+    for (auto page : pages) {
+        cache_.Remove(page);
+    }
+    return false;
+}
+
+bool FileSystem::MakeRoom() {
+    while (cache_.Full()) {
+        Page* victim = cache_.Oldest();
+        if (victim->dirty && !WriteBack(cache_.DirtyPages(victim->key.inode))) {
+            return false;
+        }
+        cache_.Remove(victim);
+    }
+    return true;
+}
+
+bool FileSystem::WriteBack(const std::vector<Page*>& pages, bool sync) {
+    struct Run {
+        std::size_t first;
+        std::size_t end;
+        BlockNumber physical;
+        bool mapped;
+    };
+    std::vector<Run> runs;
+    std::vector<IORequest> writes;
+    // Where the previous run of the batch ended, for the goal of the next.
+    InodeNumber previous_inode = kNoInode;
+    BlockNumber previous_index = 0;
+    BlockNumber previous_physical = 0;
+    std::size_t i = 0;
+    while (i < pages.size()) {
+        // Extend the run while the pages are consecutive and either all
+        // unmapped or mapped to consecutive blocks.
+        InodeNumber inode = pages[i]->key.inode;
+        BlockNumber first = pages[i]->key.index;
+        ExtentTree& extents = extents_[inode];
+        Run run;
+        run.first = i;
+        run.mapped = extents.Lookup(first, &run.physical);
+        std::size_t j = i + 1;
+        while (j < pages.size() && j - i < kMaxWriteBack &&
+               pages[j]->key.inode == inode && pages[j]->key.index == first + (j - i)) {
+            BlockNumber next;
+            bool next_mapped = extents.Lookup(pages[j]->key.index, &next);
+            if (next_mapped != run.mapped || (run.mapped && next != run.physical + (j - i))) {
+                break;
+            }
+            j++;
+        }
+        run.end = j;
+        if (!run.mapped) {
+            // Put the run right after the block of the page before it, so
+            // that files written in pieces stay contiguous.
+            BlockNumber goal = FreeSpaceManager::kNoGoal;
+            BlockNumber before;
+            if (previous_inode == inode && previous_index == first) {
+                goal = previous_physical;
+            } else if (first > 0 && extents.Lookup(first - 1, &before)) {
+                goal = before + 1;
+            }
+            run.physical = Allocate(j - i, goal);
+        }
+        previous_inode = inode;
+        previous_index = first + (j - i);
+        previous_physical = run.physical + (j - i);
+        IORequest write;
+        write.op = IORequest::Op::kWrite;
+        write.offset = run.physical * kPageSize;
+        for (std::size_t k = i; k < j; k++) {
+            write.iov.push_back({pages[k]->data.data(), kPageSize});
+        }
+        runs.push_back(run);
+        writes.push_back(std::move(write));
+        i = j;
+    }
+    if (writes.empty() && !sync) {
+        return true;
+    }
+
+    bool ok = sync ? backend_->WriteAndSync(writes) : backend_->Submit(writes);
+    device_writes_ += writes.size();
+    for (std::size_t k = 0; k < runs.size(); k++) {
+        const Run& run = runs[k];
+        if (writes[k].result != static_cast<long>(writes[k].size())) {
+            if (!run.mapped) {
+                free_space_.Free(run.physical, run.end - run.first);
+            }
+            ok = false;
+            continue;
+        }
+        if (!run.mapped) {
+            extents_[pages[run.first]->key.inode].Map(pages[run.first]->key.index,
+                                                      run.physical, run.end - run.first);
+        }
+        for (std::size_t page = run.first; page < run.end; page++) {
+            cache_.MarkClean(pages[page]);
+        }
+    }
+    return ok;
+}
+
+BlockNumber FileSystem::Allocate(BlockNumber count, BlockNumber goal) {
+    BlockNumber start;
+    while (!free_space_.Allocate(count, &start, goal)) {
+        free_space_.Grow(std::max(count, free_space_.total()));
+    }
+    return start;
+}
+} // namespace FS
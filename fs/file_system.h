@@ -0,0 +1,152 @@
+#ifndef FILE_SYSTEM_H
+#define FILE_SYSTEM_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "extent.h"
+#include "free_space.h"
+#include "io_backend.h"
+#include "metadata.h"
+#include "page_cache.h"
+
+namespace FS {
+
+    /* FileSystem is a file API over a single image file, running entirely
+     * in the calling process. Names and inodes live in a MetadataStore, the
+     * blocks of every file in an ExtentTree, and file data goes through a
+     * PageCache in front of the image.
+     *
+     * Reads that continue where the previous read on the same descriptor
+     * stopped open a readahead window that doubles up to kMaxReadahead
+     * pages, and all missing pages of a read plus its window are fetched
+     * with one read. Writes only dirty cached pages. Blocks are allocated
+     * when the pages are written back, on Fsync, Sync or eviction, so runs
+     * of consecutive dirty pages get contiguous blocks and go out with one
+     * write each.
+     *
+     * Device I/O goes through an IOBackend, io_uring where available. Runs
+     * of a write-back are submitted together, Fsync and Sync chain them
+     * with the fdatasync, and ReadMany fetches the missing pages of many
+     * reads at once, keeping up to kQueueDepth of them in flight.
+     *
+     * Blocks come from a FreeSpaceManager, which grows the image when it
+     * runs out of room. Inodes, block maps and the free space are kept in
+     * memory only, so the image is created anew every time.
+     */
+    class FileSystem {
+        public:
+            static const std::size_t kPageSize = 4096;
+            static const std::size_t kMinReadahead = 4;
+            static const std::size_t kMaxReadahead = 32;
+            // Pages written back with a single device write at most.
+            static const std::size_t kMaxWriteBack = 256;
+            static const unsigned kQueueDepth = 64;
+            // Blocks of a new image, it doubles whenever it is full.
+            static const BlockNumber kInitialBlocks = 1024;
+
+            // Open flags.
+            static const int kCreate = 1;
+
+            // Creates or truncates the image, ok() tells whether that worked.
+            // The cache holds at least 2 * kMaxReadahead pages. Without
+            // async_io all I/O uses blocking system calls.
+            explicit FileSystem(const std::string& image, std::size_t cache_pages = 4096,
+                                bool async_io = true);
+            // Writes back all dirty pages.
+            ~FileSystem();
+            FileSystem(const FileSystem&) = delete;
+            FileSystem& operator=(const FileSystem&) = delete;
+
+            bool ok() { return image_fd_ >= 0; }
+
+            // Opens a regular file by absolute path and returns a
+            // descriptor, or -1.
+            int Open(const std::string& path, int flags = 0);
+            bool Close(int fd);
+            bool Mkdir(const std::string& path);
+            // Removes a file or an empty directory. Blocks of a file are
+            // freed with its last link, descriptors still open on it stop
+            // working.
+            bool Unlink(const std::string& path);
+
+            // Like pread and pwrite, the number of bytes transferred or -1.
+            long Pread(int fd, void* buf, std::size_t count, std::uint64_t offset);
+            long Pwrite(int fd, const void* buf, std::size_t count, std::uint64_t offset);
+
+            struct ReadRequest {
+                void* buf;
+                std::size_t count;
+                std::uint64_t offset;
+                // Like the return value of Pread.
+                long result;
+            };
+            // Many reads of one file, the pages missing from the cache are
+            // read in one batch. False if any of the reads failed.
+            bool ReadMany(int fd, std::vector<ReadRequest>& requests);
+            // Writes back the dirty pages of the file and syncs the image.
+            bool Fsync(int fd);
+            // Same for all files.
+            bool Sync();
+
+            MetadataStore& metadata() { return metadata_; }
+            PageCache& cache() { return cache_; }
+            FreeSpaceManager& free_space() { return free_space_; }
+            // Block map of the file behind fd, nullptr for bad descriptors.
+            ExtentTree* Extents(int fd);
+
+            const char* backend() { return backend_->name(); }
+            // Requests issued against the image.
+            std::size_t device_reads() { return device_reads_; }
+            std::size_t device_writes() { return device_writes_; }
+
+        private:
+            struct OpenFile {
+                InodeNumber inode = kNoInode;
+                // Where the next sequential read would start, and the
+                // current readahead window in pages.
+                std::uint64_t next_offset = 0;
+                std::size_t window = 0;
+            };
+
+            OpenFile* GetFile(int fd);
+            bool SplitPath(const std::string& path, InodeNumber* parent,
+                           std::string* name);
+            // Copies from cached pages, reading missing pages with window
+            // pages of readahead.
+            long ReadPages(InodeNumber inode, std::uint64_t size, void* buf,
+                           std::size_t count, std::uint64_t offset, std::size_t window);
+            // Reads index, and after it the missing pages up to limit that
+            // are in the same extent, into the cache.
+            Page* Fill(InodeNumber inode, BlockNumber index, BlockNumber limit);
+            // Adds the pages from index up to end, stopping at the first one
+            // that is cached, and the request reading them from extent.
+            void PrepareRead(InodeNumber inode, const Extent& extent, BlockNumber index,
+                             BlockNumber end, std::vector<Page*>* pages,
+                             IORequest* request);
+            // Drops the pages again if the request failed.
+            bool FinishRead(const IORequest& request, const std::vector<Page*>& pages);
+            // Evicts pages until there is room for one more.
+            bool MakeRoom();
+            // Writes the pages back, followed by fdatasync if sync.
+            bool WriteBack(const std::vector<Page*>& pages, bool sync = false);
+            // Contiguous blocks, at goal if possible, growing the image if
+            // there is no free extent long enough.
+            BlockNumber Allocate(BlockNumber count, BlockNumber goal);
+
+            int image_fd_;
+            MetadataStore metadata_;
+            std::unordered_map<InodeNumber, ExtentTree> extents_;
+            std::vector<OpenFile> files_;
+            PageCache cache_;
+            std::unique_ptr<IOBackend> backend_;
+            FreeSpaceManager free_space_;
+            std::size_t device_reads_ = 0;
+            std::size_t device_writes_ = 0;
+    };
+} // namespace FS
+
+#endif // FILE_SYSTEM_H
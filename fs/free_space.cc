@@ -0,0 +1,290 @@
+#include "free_space.h"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace FS {
+
+const BlockNumber FreeSpaceManager::kNoGoal;
+
+namespace {
+
+const std::uint64_t kFull = ~std::uint64_t(0);
+const std::uint64_t kMagic = 0x3143505345455246; // "FREESPC1"
+
+struct Header {
+    std::uint64_t magic;
+    std::uint64_t total;
+    std::uint64_t extents;
+    std::uint64_t checksum;
+};
+
+std::uint64_t Checksum(const std::vector<std::uint64_t>& words) {
+    // FNV-1a over the words.
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (auto word : words) {
+        hash = (hash ^ word) * 0x100000001b3;
+    }
+    return hash;
+}
+
+std::size_t Words(std::uint64_t bits) {
+    return (bits + 63) / 64;
+}
+} // namespace
+
+FreeSpaceManager::FreeSpaceManager(BlockNumber total) {
+    Grow(total);
+}
+
+bool FreeSpaceManager::Allocate(BlockNumber count, BlockNumber* start, BlockNumber goal) {
+    if (count == 0 || count > free_) {
+        return false;
+    }
+    if (goal != kNoGoal && goal < total_) {
+        auto item = by_start_.Floor(goal);
+        if (item != nullptr && item->key() + item->value() >= goal + count) {
+            Take(item->key(), item->value(), goal, count);
+            *start = goal;
+            return true;
+        }
+    }
+    if (count == 1) {
+        BlockNumber block = FindFree(0);
+        auto item = by_start_.Floor(block);
+        Take(item->key(), item->value(), block, 1);
+        *start = block;
+        return true;
+    }
+    SizeKey best = {0, 0};
+    by_size_.Scan({count, 0}, [&best](BTree::Item<SizeKey, BlockNumber>* item) {
+        best = item->key();
+        return false;
+    });
+    if (best.length == 0) {
+        return false;
+    }
+    Take(best.start, best.length, best.start, count);
+    *start = best.start;
+    return true;
+}
+
+bool FreeSpaceManager::Free(BlockNumber start, BlockNumber count) {
+    if (count == 0 || start > total_ || count > total_ - start || !AllUsed(start, count)) {
+        return false;
+    }
+    SetBits(start, count, false);
+    free_ += count;
+
+    // Coalesce with the free extents right before and after.
+    BlockNumber length = count;
+    auto before = by_start_.Floor(start);
+    if (before != nullptr && before->key() + before->value() == start) {
+        BlockNumber before_start = before->key();
+        length += before->value();
+        RemoveExtent(before_start, before->value());
+        start = before_start;
+    }
+    auto after = by_start_.Find(start + length);
+    if (after != nullptr) {
+        BlockNumber after_length = after->value();
+        RemoveExtent(start + length, after_length);
+        length += after_length;
+    }
+    AddExtent(start, length);
+    return true;
+}
+
+void FreeSpaceManager::Grow(BlockNumber blocks) {
+    if (blocks == 0) {
+        return;
+    }
+    BlockNumber old_total = total_;
+    total_ += blocks;
+    // New bits start out used, so that the padding of the last word is
+    // never found free, and are then freed block by block range.
+    bitmap_.resize(Words(total_), kFull);
+    summary_.resize(Words(bitmap_.size()), kFull);
+    SetBits(old_total, blocks, true);
+    for (std::size_t word = old_total / 64; word < bitmap_.size(); word++) {
+        UpdateSummary(word);
+    }
+    // Freeing coalesces with a free extent at the old end.
+    Free(old_total, blocks);
+}
+
+bool FreeSpaceManager::IsFree(BlockNumber block) {
+    return block < total_ && !(bitmap_[block / 64] >> (block % 64) & 1);
+}
+
+BlockNumber FreeSpaceManager::FindFree(BlockNumber from) {
+    if (from >= total_) {
+        return total_;
+    }
+    std::size_t word = from / 64;
+    // Bits before from count as used.
+    std::uint64_t bits = bitmap_[word] | ((std::uint64_t(1) << (from % 64)) - 1);
+    while (bits == kFull) {
+        // Find the next word that is not full in the summary.
+        word++;
+        std::size_t group = word / 64;
+        if (group >= summary_.size()) {
+            return total_;
+        }
+        std::uint64_t full = summary_[group] | ((std::uint64_t(1) << (word % 64)) - 1);
+        while (full == kFull) {
+            if (++group >= summary_.size()) {
+                return total_;
+            }
+            full = summary_[group];
+        }
+        word = group * 64 + __builtin_ctzll(~full);
+        bits = bitmap_[word];
+    }
+    BlockNumber block = word * 64 + __builtin_ctzll(~bits);
+    return std::min(block, total_);
+}
+
+std::vector<std::pair<BlockNumber, BlockNumber>> FreeSpaceManager::FreeExtents() {
+    std::vector<std::pair<BlockNumber, BlockNumber>> extents;
+    by_start_.Scan(0, [&extents](BTree::Item<BlockNumber, BlockNumber>* item) {
+        extents.push_back({item->key(), item->value()});
+        return true;
+    });
+    return extents;
+}
+
+bool FreeSpaceManager::Save(int fd, std::uint64_t offset) {
+    // Header, then the free extents, the bitmap and the summary.
+    std::vector<std::uint64_t> payload;
+    by_start_.Scan(0, [&payload](BTree::Item<BlockNumber, BlockNumber>* item) {
+        payload.push_back(item->key());
+        payload.push_back(item->value());
+        return true;
+    });
+    Header header;
+    header.magic = kMagic;
+    header.total = total_;
+    header.extents = payload.size() / 2;
+    payload.insert(payload.end(), bitmap_.begin(), bitmap_.end());
+    payload.insert(payload.end(), summary_.begin(), summary_.end());
+    header.checksum = Checksum(payload);
+
+    std::size_t bytes = payload.size() * sizeof(std::uint64_t);
+    return ::pwrite(fd, &header, sizeof(header), offset) == sizeof(header) &&
+           ::pwrite(fd, payload.data(), bytes, offset + sizeof(header)) ==
+               static_cast<ssize_t>(bytes);
+}
+
+bool FreeSpaceManager::Load(int fd, std::uint64_t offset) {
+    Header header;
+    if (::pread(fd, &header, sizeof(header), offset) != sizeof(header) ||
+        header.magic != kMagic || header.extents > header.total) {
+        return false;
+    }
+    // The sizes come from the disk, the payload has to fit into the file
+    // before it is worth allocating.
+    struct stat status;
+    if (::fstat(fd, &status) != 0 ||
+        offset + sizeof(header) > static_cast<std::uint64_t>(status.st_size)) {
+        return false;
+    }
+    std::uint64_t room = (status.st_size - offset - sizeof(header)) / sizeof(std::uint64_t);
+    if (header.total / 64 > room || header.extents > room / 2) {
+        return false;
+    }
+    std::size_t bitmap_words = Words(header.total);
+    std::size_t summary_words = Words(bitmap_words);
+    if (2 * header.extents + bitmap_words + summary_words > room) {
+        return false;
+    }
+    std::vector<std::uint64_t> payload(2 * header.extents + bitmap_words + summary_words);
+    std::size_t bytes = payload.size() * sizeof(std::uint64_t);
+    if (::pread(fd, payload.data(), bytes, offset + sizeof(header)) !=
+            static_cast<ssize_t>(bytes) ||
+        Checksum(payload) != header.checksum) {
+        return false;
+    }
+
+    auto extents_end = payload.begin() + 2 * header.extents;
+    bitmap_.assign(extents_end, extents_end + bitmap_words);
+    summary_.assign(extents_end + bitmap_words, payload.end());
+    total_ = header.total;
+    free_ = 0;
+    by_size_.Clear();
+    by_start_.Clear();
+    for (std::size_t i = 0; i < header.extents; i++) {
+        AddExtent(payload[2 * i], payload[2 * i + 1]);
+        free_ += payload[2 * i + 1];
+    }
+    return true;
+}
+
+void FreeSpaceManager::Take(BlockNumber start, BlockNumber length, BlockNumber at,
+                            BlockNumber count) {
+    RemoveExtent(start, length);
+    if (at > start) {
+        AddExtent(start, at - start);
+    }
+    if (at + count < start + length) {
+        AddExtent(at + count, start + length - at - count);
+    }
+    SetBits(at, count, true);
+    free_ -= count;
+}
+
+void FreeSpaceManager::AddExtent(BlockNumber start, BlockNumber length) {
+    by_start_.Insert(start, length);
+    by_size_.Insert({length, start}, start);
+}
+
+void FreeSpaceManager::RemoveExtent(BlockNumber start, BlockNumber length) {
+    by_start_.Delete(start);
+    by_size_.Delete({length, start});
+}
+
+void FreeSpaceManager::SetBits(BlockNumber start, BlockNumber count, bool used) {
+    BlockNumber end = start + count;
+    while (start < end) {
+        std::size_t word = start / 64;
+        unsigned first = start % 64;
+        unsigned last = std::min<BlockNumber>(end - word * 64, 64);
+        std::uint64_t mask = (last == 64 ? kFull : (std::uint64_t(1) << last) - 1) &
+                             ~((std::uint64_t(1) << first) - 1);
+        if (used) {
+            bitmap_[word] |= mask;
+        } else {
+            bitmap_[word] &= ~mask;
+        }
+        UpdateSummary(word);
+        start = word * 64 + last;
+    }
+}
+
+bool FreeSpaceManager::AllUsed(BlockNumber start, BlockNumber count) {
+    BlockNumber end = start + count;
+    while (start < end) {
+        std::size_t word = start / 64;
+        unsigned first = start % 64;
+        unsigned last = std::min<BlockNumber>(end - word * 64, 64);
+        std::uint64_t mask = (last == 64 ? kFull : (std::uint64_t(1) << last) - 1) &
+                             ~((std::uint64_t(1) << first) - 1);
+        if ((bitmap_[word] & mask) != mask) {
+            return false;
+        }
+        start = word * 64 + last;
+    }
+    return true;
+}
+
+void FreeSpaceManager::UpdateSummary(std::size_t word) {
+    std::uint64_t bit = std::uint64_t(1) << (word % 64);
+    if (bitmap_[word] == kFull) {
+        summary_[word / 64] |= bit;
+    } else {
+        summary_[word / 64] &= ~bit;
+    }
+}
+} // namespace FS
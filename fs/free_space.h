@@ -0,0 +1,97 @@
+#ifndef FREE_SPACE_H
+#define FREE_SPACE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "btree.h"
+#include "extent.h"
+
+namespace FS {
+
+    /* FreeSpaceManager tracks which blocks of the image are in use.
+     *
+     * A two-level bitmap has a bit per block, set when the block is used,
+     * and a summary bit per bitmap word, set when the word is full. Looking
+     * for a free block skips 4096 used blocks per summary word and finds
+     * the first zero of a word with a count-trailing-zeros.
+     *
+     * The free blocks are also indexed as extents in two trees, one keyed by
+     * (length, start) for best-fit allocation and one keyed by start, where
+     * freed blocks find the extents before and after them to coalesce with
+     * in O(log n).
+     *
+     * Save writes the bitmap and the free extents to a file in one record,
+     * Load reads them back without looking at the blocks themselves.
+     */
+    class FreeSpaceManager {
+        public:
+            // Allocations without a preferred start.
+            static const BlockNumber kNoGoal = ~BlockNumber(0);
+
+            // Starts out with total blocks, all of them free.
+            explicit FreeSpaceManager(BlockNumber total = 0);
+            FreeSpaceManager(const FreeSpaceManager&) = delete;
+            FreeSpaceManager& operator=(const FreeSpaceManager&) = delete;
+
+            // Allocates count contiguous blocks, at goal if they are free
+            // there, else the lowest free block for single blocks and the
+            // smallest free extent that fits for more. False if no free
+            // extent is long enough.
+            bool Allocate(BlockNumber count, BlockNumber* start, BlockNumber goal = kNoGoal);
+            // Frees the blocks, false without changing anything if some of
+            // them are not in use.
+            bool Free(BlockNumber start, BlockNumber count);
+            // Adds blocks free blocks at the end.
+            void Grow(BlockNumber blocks);
+
+            bool IsFree(BlockNumber block);
+            // First free block not before from, total() if there is none.
+            BlockNumber FindFree(BlockNumber from);
+            // Free extents as (start, length) in block order.
+            std::vector<std::pair<BlockNumber, BlockNumber>> FreeExtents();
+
+            BlockNumber total() { return total_; }
+            BlockNumber free_blocks() { return free_; }
+
+            // Writes the state at offset of fd, false if that failed.
+            bool Save(int fd, std::uint64_t offset);
+            // Replaces the state with the one saved at offset, false without
+            // changing anything if there is no intact record.
+            bool Load(int fd, std::uint64_t offset);
+
+        private:
+            struct SizeKey {
+                BlockNumber length;
+                BlockNumber start;
+
+                bool operator<(const SizeKey& other) const {
+                    if (length != other.length) {
+                        return length < other.length;
+                    }
+                    return start < other.start;
+                }
+                bool operator==(const SizeKey& other) const {
+                    return length == other.length && start == other.start;
+                }
+            };
+
+            // Takes count blocks at at out of the free extent [start, start + length).
+            void Take(BlockNumber start, BlockNumber length, BlockNumber at, BlockNumber count);
+            void AddExtent(BlockNumber start, BlockNumber length);
+            void RemoveExtent(BlockNumber start, BlockNumber length);
+            void SetBits(BlockNumber start, BlockNumber count, bool used);
+            bool AllUsed(BlockNumber start, BlockNumber count);
+            void UpdateSummary(std::size_t word);
+
+            std::vector<std::uint64_t> bitmap_;
+            std::vector<std::uint64_t> summary_;
+            BTree::Tree<SizeKey, BlockNumber> by_size_;
+            BTree::Tree<BlockNumber, BlockNumber> by_start_;
+            BlockNumber total_ = 0;
+            BlockNumber free_ = 0;
+    };
+} // namespace FS
+
+#endif // FREE_SPACE_H
@@ -0,0 +1,293 @@
+#include "io_backend.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace FS {
+
+std::size_t IORequest::size() const {
+    std::size_t total = 0;
+    for (const auto& vec : iov) {
+        total += vec.iov_len;
+    }
+    return total;
+}
+
+std::unique_ptr<IOBackend> IOBackend::Create(int fd, unsigned queue_depth) {
+    auto uring = UringBackend::Create(fd, queue_depth);
+    if (uring != nullptr) {
+        return std::unique_ptr<IOBackend>(std::move(uring));
+    }
+    return std::unique_ptr<IOBackend>(new SyncBackend(fd));
+}
+
+bool SyncBackend::Submit(std::vector<IORequest>& requests) {
+    bool ok = true;
+    for (auto& request : requests) {
+        ssize_t done;
+        if (request.op == IORequest::Op::kRead) {
+            done = ::preadv(fd_, request.iov.data(), request.iov.size(), request.offset);
+        } else {
+            done = ::pwritev(fd_, request.iov.data(), request.iov.size(), request.offset);
+        }
+        request.result = done < 0 ? -errno : done;
+        ok = ok && done >= 0;
+    }
+    return ok;
+}
+
+bool SyncBackend::WriteAndSync(std::vector<IORequest>& writes) {
+    if (!Submit(writes)) {
+        return false;
+    }
+    for (const auto& write : writes) {
+        if (static_cast<std::size_t>(write.result) != write.size()) {
+            return false;
+        }
+    }
+    return ::fdatasync(fd_) == 0;
+}
+
+std::unique_ptr<UringBackend> UringBackend::Create(int fd, unsigned queue_depth) {
+    std::unique_ptr<UringBackend> backend(new UringBackend(fd));
+    if (!backend->Setup(queue_depth)) {
+        return nullptr;
+    }
+    return backend;
+}
+
+UringBackend::~UringBackend() {
+    Close();
+}
+
+void UringBackend::Close() {
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+        ::munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+    }
+    sqes_ = nullptr;
+    cq_ring_ = sq_ring_ = nullptr;
+    ring_fd_ = -1;
+}
+
+bool UringBackend::Setup(unsigned queue_depth) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd_ = ::syscall(__NR_io_uring_setup, std::max(queue_depth, 1u), &params);
+    if (ring_fd_ < 0) {
+        return false;
+    }
+    entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        return false;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+void UringBackend::Prepare(IORequest& request, std::uint64_t index, bool link) {
+    unsigned tail = *sq_tail_;
+    unsigned slot = tail & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request.op == IORequest::Op::kRead ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = fd_;
+    sqe->off = request.offset;
+    sqe->addr = reinterpret_cast<std::uint64_t>(request.iov.data());
+    sqe->len = request.iov.size();
+    sqe->user_data = index;
+    if (link) {
+        sqe->flags = IOSQE_IO_LINK;
+    }
+    sq_array_[slot] = slot;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    pending_++;
+}
+
+void UringBackend::PrepareSync(std::uint64_t index) {
+    unsigned tail = *sq_tail_;
+    unsigned slot = tail & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd_;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    sqe->user_data = index;
+    sq_array_[slot] = slot;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    pending_++;
+}
+
+template<typename F>
+bool UringBackend::Enter(unsigned wait, F done) {
+    while (true) {
+        int ret = ::syscall(__NR_io_uring_enter, ring_fd_, pending_, wait,
+                            wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if (ret >= 0) {
+            pending_ -= std::min<unsigned>(ret, pending_);
+            if (pending_ == 0) {
+                break;
+            }
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return false;
+        }
+    }
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        done(cqes_[head & *cq_mask_]);
+        head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return true;
+}
+
+template<typename F>
+void UringBackend::Drain(std::size_t outstanding, F done) {
+    // Without SQPOLL the kernel only consumes entries inside
+    // io_uring_enter, the ones it has not taken never run.
+    unsigned unsubmitted = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sq_tail_, *sq_tail_ - unsubmitted, __ATOMIC_RELEASE);
+    pending_ = 0;
+    outstanding -= std::min<std::size_t>(unsubmitted, outstanding);
+    auto count = [&](const io_uring_cqe& cqe) {
+        done(cqe);
+        outstanding--;
+    };
+    while (outstanding > 0) {
+        if (!Enter(1, count)) {
+            // Closing the ring cancels what is left, there is nothing
+            // better to do.
+            Close();
+            fallback_.reset(new SyncBackend(fd_));
+            return;
+        }
+    }
+}
+
+bool UringBackend::Submit(std::vector<IORequest>& requests) {
+    if (fallback_ != nullptr) {
+        return fallback_->Submit(requests);
+    }
+    return Submit(requests.data(), requests.size());
+}
+
+bool UringBackend::Submit(IORequest* requests, std::size_t count) {
+    std::size_t next = 0;
+    std::size_t in_flight = 0;
+    std::size_t completed = 0;
+    bool ok = true;
+    auto done = [&](const io_uring_cqe& cqe) {
+        requests[cqe.user_data].result = cqe.res;
+        ok = ok && cqe.res >= 0;
+        in_flight--;
+        completed++;
+    };
+    while (completed < count) {
+        while (next < count && in_flight < entries_) {
+            Prepare(requests[next], next, false);
+            next++;
+            in_flight++;
+        }
+        if (!Enter(1, done)) {
+            Drain(in_flight, done);
+            return false;
+        }
+    }
+    return ok;
+}
+
+bool UringBackend::WriteAndSync(std::vector<IORequest>& writes) {
+    if (fallback_ != nullptr) {
+        return fallback_->WriteAndSync(writes);
+    }
+    // The chain has to fit into the ring, writes in front of it go out as
+    // a plain batch and have completed by the time the chain starts.
+    std::size_t chained = std::min<std::size_t>(writes.size(), entries_ - 1);
+    std::size_t first = writes.size() - chained;
+    if (first > 0) {
+        bool ok = Submit(writes.data(), first);
+        for (std::size_t i = 0; i < first; i++) {
+            ok = ok && static_cast<std::size_t>(writes[i].result) == writes[i].size();
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    for (std::size_t i = first; i < writes.size(); i++) {
+        Prepare(writes[i], i, true);
+    }
+    PrepareSync(writes.size());
+    std::size_t completed = 0;
+    bool ok = true;
+    auto done = [&](const io_uring_cqe& cqe) {
+        if (cqe.user_data == writes.size()) {
+            ok = ok && cqe.res >= 0;
+        } else {
+            IORequest& write = writes[cqe.user_data];
+            write.result = cqe.res;
+            ok = ok && cqe.res >= 0 && static_cast<std::size_t>(cqe.res) == write.size();
+        }
+        completed++;
+    };
+    while (completed < chained + 1) {
+        if (!Enter(1, done)) {
+            Drain(chained + 1 - completed, done);
+            return false;
+        }
+    }
+    return ok;
+}
+} // namespace FS
@@ -0,0 +1,136 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace FS {
+
+    struct IORequest {
+        enum class Op { kRead, kWrite };
+
+        Op op = Op::kRead;
+        std::uint64_t offset = 0;
+        std::vector<iovec> iov;
+        // Bytes transferred or -errno, filled in by the backend.
+        long result = 0;
+
+        std::size_t size() const;
+    };
+
+    /* IOBackend runs batches of vectored reads and writes against one file
+     * descriptor. Requests of a batch may complete in any order, the call
+     * returns once all of them did.
+     */
+    class IOBackend {
+        public:
+            virtual ~IOBackend() {}
+
+            // Runs the requests, false if any of them failed. Short
+            // transfers are not failures, result tells how much was done.
+            virtual bool Submit(std::vector<IORequest>& requests) = 0;
+            // Runs the writes, then fdatasync, which only succeeds if all
+            // the writes did.
+            virtual bool WriteAndSync(std::vector<IORequest>& writes) = 0;
+            virtual const char* name() = 0;
+
+            // io_uring if the kernel lets us set up a ring, blocking
+            // preadv/pwritev otherwise.
+            static std::unique_ptr<IOBackend> Create(int fd, unsigned queue_depth);
+    };
+
+    // One blocking system call per request.
+    class SyncBackend : public IOBackend {
+        public:
+            explicit SyncBackend(int fd) : fd_(fd) {}
+
+            bool Submit(std::vector<IORequest>& requests) override;
+            bool WriteAndSync(std::vector<IORequest>& writes) override;
+            const char* name() override { return "sync"; }
+
+        private:
+            int fd_;
+    };
+
+    /* UringBackend keeps up to queue_depth requests in flight on an
+     * io_uring, set up with the raw system calls so that there is no
+     * dependency on liburing. WriteAndSync submits the writes and the
+     * fsync as one linked chain, the kernel runs them in order and cancels
+     * the rest of the chain once a link fails.
+     *
+     * No call returns while the kernel still has one of its requests,
+     * their buffers belong to the caller. If io_uring_enter fails, the
+     * entries not submitted yet are taken back and the ones in flight are
+     * waited for. A ring that cannot even do that is closed, and the
+     * backend goes on with blocking system calls.
+     */
+    class UringBackend : public IOBackend {
+        public:
+            // nullptr if the ring cannot be set up.
+            static std::unique_ptr<UringBackend> Create(int fd, unsigned queue_depth);
+            ~UringBackend();
+            UringBackend(const UringBackend&) = delete;
+            UringBackend& operator=(const UringBackend&) = delete;
+
+            bool Submit(std::vector<IORequest>& requests) override;
+            bool WriteAndSync(std::vector<IORequest>& writes) override;
+            const char* name() override {
+                return fallback_ != nullptr ? fallback_->name() : "io_uring";
+            }
+
+            unsigned queue_depth() { return entries_; }
+
+        private:
+            UringBackend(int fd) : fd_(fd) {}
+            bool Setup(unsigned queue_depth);
+            bool Submit(IORequest* requests, std::size_t count);
+            // Queues a request, user_data is the index into the batch.
+            void Prepare(IORequest& request, std::uint64_t index, bool link);
+            void PrepareSync(std::uint64_t index);
+            // Submits what was prepared and waits for at least wait
+            // completions, which are handed to done.
+            template<typename F>
+            bool Enter(unsigned wait, F done);
+            // After a failed Enter: takes back the entries not submitted and
+            // waits for the rest of the outstanding ones, those prepared
+            // and not yet completed. Falls back to blocking calls if the
+            // ring is broken.
+            template<typename F>
+            void Drain(std::size_t outstanding, F done);
+            // Unmaps and closes the ring.
+            void Close();
+
+            int fd_;
+            int ring_fd_ = -1;
+            unsigned entries_ = 0;
+            // Prepared, not yet submitted entries.
+            unsigned pending_ = 0;
+
+            void* sq_ring_ = nullptr;
+            void* cq_ring_ = nullptr;
+            std::size_t sq_ring_size_ = 0;
+            std::size_t cq_ring_size_ = 0;
+            io_uring_sqe* sqes_ = nullptr;
+            std::size_t sqes_size_ = 0;
+
+            unsigned* sq_head_ = nullptr;
+            unsigned* sq_tail_ = nullptr;
+            unsigned* sq_mask_ = nullptr;
+            unsigned* sq_array_ = nullptr;
+            unsigned* cq_head_ = nullptr;
+            unsigned* cq_tail_ = nullptr;
+            unsigned* cq_mask_ = nullptr;
+            io_uring_cqe* cqes_ = nullptr;
+
+            // Runs the requests once the ring is closed.
+            std::unique_ptr<SyncBackend> fallback_;
+    };
+} // namespace FS
+
+#endif // IO_BACKEND_H
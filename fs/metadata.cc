@@ -0,0 +1,182 @@
+#include "metadata.h"
+
+namespace FS {
+
+MetadataStore::MetadataStore() {
+    Inode root;
+    root.number = next_inode_++;
+    root.type = FileType::kDirectory;
+    root.links = 1;
+    inodes_.Insert(root.number, root);
+}
+
+InodeNumber MetadataStore::Create(InodeNumber parent, const std::string& name,
+                                  FileType type) {
+    if (name.empty() || !IsDirectory(parent) || Lookup(parent, name) != kNoInode) {
+        return kNoInode;
+    }
+    Inode inode;
+    inode.number = next_inode_++;
+    inode.type = type;
+    inode.links = 1;
+    if (type == FileType::kDirectory) {
+        inode.parent = parent;
+    }
+    inodes_.Insert(inode.number, inode);
+    entries_.Insert({parent, name}, inode.number);
+    return inode.number;
+}
+
+bool MetadataStore::Unlink(InodeNumber parent, const std::string& name) {
+    InodeNumber number = Lookup(parent, name);
+    if (number == kNoInode) {
+        return false;
+    }
+    auto item = inodes_.Find(number);
+    Inode inode = item->value();
+    if (inode.type == FileType::kDirectory && !IsEmpty(number)) {
+        return false;
+    }
+    DirKey key = {parent, name};
+    Forget(key);
+    entries_.Delete(key);
+    if (--inode.links == 0) {
+        inodes_.Delete(number);
+    } else {
+        item->SetValue(inode);
+    }
+    return true;
+}
+
+bool MetadataStore::Rename(InodeNumber parent, const std::string& name,
+                           InodeNumber new_parent, const std::string& new_name) {
+    InodeNumber number = Lookup(parent, name);
+    if (number == kNoInode || new_name.empty() || !IsDirectory(new_parent) ||
+        Lookup(new_parent, new_name) != kNoInode) {
+        return false;
+    }
+    auto item = inodes_.Find(number);
+    Inode inode = item->value();
+    if (inode.type == FileType::kDirectory) {
+        // Below itself it would be cut off from the root.
+        if (IsWithin(new_parent, number)) {
+            return false;
+        }
+        inode.parent = new_parent;
+        item->SetValue(inode);
+    }
+    DirKey key = {parent, name};
+    Forget(key);
+    entries_.Delete(key);
+    entries_.Insert({new_parent, new_name}, number);
+    return true;
+}
+
+InodeNumber MetadataStore::Lookup(InodeNumber parent, const std::string& name) {
+    DirKey key = {parent, name};
+    auto cached = lookup_cache_.find(key);
+    if (cached != lookup_cache_.end()) {
+        cache_hits_++;
+        return cached->second;
+    }
+    cache_misses_++;
+    auto item = entries_.Find(key);
+    if (item == nullptr) {
+        return kNoInode;
+    }
+    if (lookup_cache_.size() >= kCacheCapacity) {
+        lookup_cache_.clear();
+    }
+    lookup_cache_[key] = item->value();
+    return item->value();
+}
+
+InodeNumber MetadataStore::Resolve(const std::string& path) {
+    if (path.empty() || path[0] != '/') {
+        return kNoInode;
+    }
+    InodeNumber current = kRootInode;
+    std::size_t start = 1;
+    while (start < path.size() && current != kNoInode) {
+        std::size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        if (end > start) {
+            current = Lookup(current, path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return current;
+}
+
+bool MetadataStore::GetInode(InodeNumber number, Inode* inode) {
+    auto item = inodes_.Find(number);
+    if (item == nullptr) {
+        return false;
+    }
+    *inode = item->value();
+    return true;
+}
+
+bool MetadataStore::SetSize(InodeNumber number, std::uint64_t size) {
+    auto item = inodes_.Find(number);
+    if (item == nullptr) {
+        return false;
+    }
+    Inode inode = item->value();
+    inode.size = size;
+    item->SetValue(inode);
+    return true;
+}
+
+std::vector<DirEntry> MetadataStore::List(InodeNumber dir) {
+    std::vector<DirEntry> listing;
+    ForEachEntry(dir, [&listing](const DirEntry& entry) {
+        listing.push_back(entry);
+        return true;
+    });
+    return listing;
+}
+
+void MetadataStore::ForEachEntry(InodeNumber dir,
+                                 std::function<bool(const DirEntry&)> fn) {
+    // The empty name sorts before every other name in the directory.
+    entries_.Scan({dir, ""}, [dir, &fn](BTree::Item<DirKey, InodeNumber>* item) {
+        DirKey key = item->key();
+        if (key.parent != dir) {
+            return false;
+        }
+        return fn({key.name, item->value()});
+    });
+}
+
+bool MetadataStore::IsDirectory(InodeNumber number) {
+    auto item = inodes_.Find(number);
+    return item != nullptr && item->value().type == FileType::kDirectory;
+}
+
+bool MetadataStore::IsEmpty(InodeNumber dir) {
+    bool empty = true;
+    ForEachEntry(dir, [&empty](const DirEntry&) {
+        empty = false;
+        return false;
+    });
+    return empty;
+}
+
+bool MetadataStore::IsWithin(InodeNumber dir, InodeNumber ancestor) {
+    while (dir != kNoInode) {
+        if (dir == ancestor) {
+            return true;
+        }
+        dir = inodes_.Find(dir)->value().parent;
+    }
+    return false;
+}
+
+void MetadataStore::Forget(const DirKey& key) {
+    lookup_cache_.erase(key);
+}
+
+} // namespace FS
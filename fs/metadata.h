@@ -0,0 +1,119 @@
+#ifndef METADATA_H
+#define METADATA_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "btree.h"
+
+namespace FS {
+
+    using InodeNumber = std::uint64_t;
+
+    // Inode numbers start at one, zero means "no such inode".
+    const InodeNumber kNoInode = 0;
+    const InodeNumber kRootInode = 1;
+
+    enum class FileType { kFile, kDirectory };
+
+    struct Inode {
+        InodeNumber number = kNoInode;
+        FileType type = FileType::kFile;
+        std::uint64_t size = 0;
+        std::uint32_t links = 0;
+        // Directory holding the entry of a directory, kNoInode for the
+        // root and for files.
+        InodeNumber parent = kNoInode;
+    };
+
+    /* DirKey identifies a directory entry. Entries sort by parent first, so
+     * all entries of one directory are next to each other in the tree and
+     * listing it is a range scan starting at {parent, ""}.
+     */
+    struct DirKey {
+        InodeNumber parent;
+        std::string name;
+
+        bool operator<(const DirKey& other) const {
+            if (parent != other.parent) {
+                return parent < other.parent;
+            }
+            return name < other.name;
+        }
+        bool operator==(const DirKey& other) const {
+            return parent == other.parent && name == other.name;
+        }
+    };
+
+    struct DirKeyHash {
+        std::size_t operator()(const DirKey& key) const {
+            return std::hash<std::string>()(key.name) * 31 + key.parent;
+        }
+    };
+
+    struct DirEntry {
+        std::string name;
+        InodeNumber inode;
+    };
+
+    /* MetadataStore keeps inodes and directory entries of the filesystem in
+     * two trees: inodes keyed by their number and directory entries keyed
+     * by (parent inode, name). Path resolution goes component by component
+     * through a cache of recent lookups in front of the entry tree.
+     */
+    class MetadataStore {
+        public:
+            MetadataStore();
+
+            // Creates a file or directory under parent. Returns its inode
+            // number, or kNoInode if parent is not a directory or the name
+            // is taken.
+            InodeNumber Create(InodeNumber parent, const std::string& name,
+                               FileType type);
+            // Removes the entry, directories have to be empty. Inodes of
+            // files go away with their last link.
+            bool Unlink(InodeNumber parent, const std::string& name);
+            // Moves the entry, a directory cannot go below itself.
+            bool Rename(InodeNumber parent, const std::string& name,
+                        InodeNumber new_parent, const std::string& new_name);
+
+            InodeNumber Lookup(InodeNumber parent, const std::string& name);
+            // Resolves an absolute path such as "/a/b/c".
+            InodeNumber Resolve(const std::string& path);
+
+            // Copies the inode into inode, false if there is no such inode.
+            bool GetInode(InodeNumber number, Inode* inode);
+            bool SetSize(InodeNumber number, std::uint64_t size);
+
+            // Entries of a directory in name order, O(log n + k).
+            std::vector<DirEntry> List(InodeNumber dir);
+            // Like List, but visits the entries until fn returns false.
+            void ForEachEntry(InodeNumber dir,
+                              std::function<bool(const DirEntry&)> fn);
+
+            std::size_t cache_hits() { return cache_hits_; }
+            std::size_t cache_misses() { return cache_misses_; }
+
+            // Lookups cached before the cache gets cleared.
+            static const std::size_t kCacheCapacity = 4096;
+
+        private:
+            bool IsDirectory(InodeNumber number);
+            bool IsEmpty(InodeNumber dir);
+            // Whether dir is ancestor or a directory below it.
+            bool IsWithin(InodeNumber dir, InodeNumber ancestor);
+            void Forget(const DirKey& key);
+
+            BTree::Tree<InodeNumber, Inode> inodes_;
+            BTree::Tree<DirKey, InodeNumber> entries_;
+            std::unordered_map<DirKey, InodeNumber, DirKeyHash> lookup_cache_;
+            InodeNumber next_inode_ = kRootInode;
+            std::size_t cache_hits_ = 0;
+            std::size_t cache_misses_ = 0;
+    };
+} // namespace FS
+
+#endif // METADATA_H
@@ -0,0 +1,109 @@
+#include "page_cache.h"
+
+namespace FS {
+
+PageCache::PageCache(std::size_t capacity, std::size_t page_size)
+    : capacity_(capacity), page_size_(page_size) {
+}
+
+PageCache::~PageCache() {
+    for (auto page : lru_) {
+        delete page;
+    }
+}
+
+Page* PageCache::Find(const PageKey& key) {
+    auto item = pages_.Find(key);
+    if (item == nullptr) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    Page* page = item->value();
+    lru_.splice(lru_.begin(), lru_, page->lru);
+    return page;
+}
+
+bool PageCache::Touch(const PageKey& key) {
+    auto item = pages_.Find(key);
+    if (item == nullptr) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, item->value()->lru);
+    return true;
+}
+
+Page* PageCache::Add(const PageKey& key) {
+    Page* page = new Page();
+    page->key = key;
+    page->data.assign(page_size_, 0);
+    lru_.push_front(page);
+    page->lru = lru_.begin();
+    pages_.Insert(key, page);
+    return page;
+}
+
+void PageCache::Remove(Page* page) {
+    MarkClean(page);
+    pages_.Delete(page->key);
+    lru_.erase(page->lru);
+    delete page;
+}
+
+void PageCache::Drop(InodeNumber inode) {
+    std::vector<Page*> pages;
+    pages_.Scan({inode, 0}, [&](BTree::Item<PageKey, Page*>* item) {
+        if (item->key().inode != inode) {
+            return false;
+        }
+        pages.push_back(item->value());
+        return true;
+    });
+    for (auto page : pages) {
+        Remove(page);
+    }
+}
+
+Page* PageCache::Oldest() {
+    if (lru_.empty()) {
+        return nullptr;
+    }
+    return lru_.back();
+}
+
+void PageCache::MarkDirty(Page* page) {
+    if (!page->dirty) {
+        page->dirty = true;
+        dirty_.Insert(page->key, page);
+        dirty_count_++;
+    }
+}
+
+void PageCache::MarkClean(Page* page) {
+    if (page->dirty) {
+        page->dirty = false;
+        dirty_.Delete(page->key);
+        dirty_count_--;
+    }
+}
+
+std::vector<Page*> PageCache::DirtyPages(InodeNumber inode) {
+    return CollectDirty({inode, 0}, inode, false);
+}
+
+std::vector<Page*> PageCache::DirtyPages() {
+    return CollectDirty({kNoInode, 0}, kNoInode, true);
+}
+
+std::vector<Page*> PageCache::CollectDirty(PageKey from, InodeNumber inode, bool all) {
+    std::vector<Page*> pages;
+    dirty_.Scan(from, [&](BTree::Item<PageKey, Page*>* item) {
+        if (!all && item->key().inode != inode) {
+            return false;
+        }
+        pages.push_back(item->value());
+        return true;
+    });
+    return pages;
+}
+} // namespace FS
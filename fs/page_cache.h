@@ -0,0 +1,94 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "btree.h"
+#include "extent.h"
+#include "metadata.h"
+
+namespace FS {
+
+    // Identifies the index-th page of a file.
+    struct PageKey {
+        InodeNumber inode;
+        BlockNumber index;
+
+        bool operator<(const PageKey& other) const {
+            if (inode != other.inode) {
+                return inode < other.inode;
+            }
+            return index < other.index;
+        }
+        bool operator==(const PageKey& other) const {
+            return inode == other.inode && index == other.index;
+        }
+    };
+
+    struct Page {
+        PageKey key;
+        bool dirty = false;
+        std::vector<char> data;
+        std::list<Page*>::iterator lru;
+    };
+
+    /* PageCache holds up to capacity pages of file data, indexed by
+     * (inode, page) in a tree. Dirty pages are also kept in a second tree,
+     * so the dirty pages of one file come out in page order and consecutive
+     * ones can be written back with a single write. Replacement is LRU;
+     * the cache never evicts on its own, the owner picks the victim with
+     * Oldest() and writes it back first if it is dirty.
+     */
+    class PageCache {
+        public:
+            PageCache(std::size_t capacity, std::size_t page_size);
+            ~PageCache();
+            PageCache(const PageCache&) = delete;
+            PageCache& operator=(const PageCache&) = delete;
+
+            // Cached page or nullptr, a hit makes the page the most recent.
+            Page* Find(const PageKey& key);
+            // Like Find, without counting or touching the page.
+            bool Contains(const PageKey& key) { return pages_.Find(key) != nullptr; }
+            // Makes a cached page the most recent without counting a hit,
+            // false if it is not cached.
+            bool Touch(const PageKey& key);
+            // Adds a zeroed page, the caller makes room first.
+            Page* Add(const PageKey& key);
+            void Remove(Page* page);
+            // Removes all pages of the file, dirty ones included.
+            void Drop(InodeNumber inode);
+            // Least recently used page, nullptr if the cache is empty.
+            Page* Oldest();
+
+            void MarkDirty(Page* page);
+            void MarkClean(Page* page);
+            // Dirty pages of the file, or of all files, in key order.
+            std::vector<Page*> DirtyPages(InodeNumber inode);
+            std::vector<Page*> DirtyPages();
+
+            bool Full() { return lru_.size() >= capacity_; }
+            std::size_t size() { return lru_.size(); }
+            std::size_t capacity() { return capacity_; }
+            std::size_t dirty() { return dirty_count_; }
+            std::size_t hits() { return hits_; }
+            std::size_t misses() { return misses_; }
+
+        private:
+            std::vector<Page*> CollectDirty(PageKey from, InodeNumber inode, bool all);
+
+            BTree::Tree<PageKey, Page*> pages_;
+            BTree::Tree<PageKey, Page*> dirty_;
+            // Most recently used first.
+            std::list<Page*> lru_;
+            std::size_t capacity_;
+            std::size_t page_size_;
+            std::size_t dirty_count_ = 0;
+            std::size_t hits_ = 0;
+            std::size_t misses_ = 0;
+    };
+} // namespace FS
+
+#endif // PAGE_CACHE_H
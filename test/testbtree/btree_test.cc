@@ -2,9 +2,14 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <random>
+#include <thread>
 
 #include "bfs.h"
 #include "btree.h"
+#include "buffered_tree.h"
+#include "interleaved.h"
+#include "mvcc.h"
 #include "gtest/gtest.h"
 
 template<typename K, typename V>
@@ -323,6 +328,630 @@ TEST(FTest, TestFusingLeft) {
     BFS::Traverse(t.root(), printNodeT);
 }
 
+TEST(FTest, DeleteEverythingInRandomOrder) {
+    BTree::Tree<int, int> t;
+    std::vector<int> keys;
+    for (int i = 0; i < 500; i++) {
+        keys.push_back((i * 7919) % 1009);
+    }
+    for (auto key : keys) {
+        t.Insert(key, key * 2);
+    }
+
+    std::vector<int> to_delete = keys;
+    std::reverse(to_delete.begin(), to_delete.end());
+    std::rotate(to_delete.begin(), to_delete.begin() + 123, to_delete.end());
+    for (size_t i = 0; i < to_delete.size(); i++) {
+        t.Delete(to_delete[i]);
+        EXPECT_EQ(t.Find(to_delete[i]), nullptr);
+        if (i % 50 == 0) {
+            for (size_t j = i + 1; j < to_delete.size(); j++) {
+                auto found = t.Find(to_delete[j]);
+                ASSERT_NE(nullptr, found);
+                EXPECT_EQ(found->value(), to_delete[j] * 2);
+            }
+        }
+    }
+    EXPECT_EQ(t.root(), nullptr);
+}
+
+TEST(FTest, OrderStatistics) {
+    BTree::Tree<int, int> t;
+    std::vector<int> keys;
+    for (int i = 0; i < 300; i++) {
+        keys.push_back((i * 37) % 300 * 3);
+    }
+    // Half of the keys go in before the sizes are tracked.
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i == keys.size() / 2) {
+            t.EnableOrderStatistics();
+        }
+        t.Insert(keys[i], i);
+    }
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        t.Delete(keys[i]);
+    }
+
+    std::vector<int> sorted;
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i % 3 != 0) {
+            sorted.push_back(keys[i]);
+        }
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    EXPECT_EQ(t.root()->size(), sorted.size());
+    for (size_t k = 0; k < sorted.size(); k++) {
+        auto selected = t.Select(k);
+        ASSERT_NE(nullptr, selected);
+        EXPECT_EQ(selected->key(), sorted[k]);
+        EXPECT_EQ(t.Rank(sorted[k]), k);
+        EXPECT_EQ(t.Rank(sorted[k] + 1), k + 1);
+    }
+    EXPECT_EQ(t.Select(sorted.size()), nullptr);
+    EXPECT_EQ(t.Rank(-1), 0);
+
+    auto count = [&sorted](int lo, int hi) -> size_t {
+        if (hi < lo) {
+            return 0;
+        }
+        return std::upper_bound(sorted.begin(), sorted.end(), hi) -
+            std::lower_bound(sorted.begin(), sorted.end(), lo);
+    };
+    std::vector<std::pair<int, int>> ranges = {
+        {0, 899}, {10, 20}, {3, 3}, {4, 4}, {100, 50}, {450, 2000}
+    };
+    for (const auto& range : ranges) {
+        EXPECT_EQ(t.CountRange(range.first, range.second),
+                  count(range.first, range.second));
+    }
+}
+
+TEST(FTest, SplitAndJoin) {
+    BTree::Tree<int, int> t;
+    for (int i = 0; i < 200; i++) {
+        t.Insert(i, i * 2);
+    }
+
+    auto upper = t.SplitAt(120);
+    auto middle = t.SplitAt(50);
+    for (int i = 0; i < 200; i++) {
+        auto& part = i < 50 ? t : (i < 120 ? middle : upper);
+        auto found = part.Find(i);
+        ASSERT_NE(nullptr, found);
+        EXPECT_EQ(found->value(), i * 2);
+        EXPECT_EQ(t.Find(i) != nullptr, i < 50);
+        EXPECT_EQ(upper.Find(i) != nullptr, i >= 120);
+    }
+    EXPECT_EQ(t.CountRange(0, 199), 50);
+    EXPECT_EQ(middle.CountRange(0, 199), 70);
+    EXPECT_EQ(upper.CountRange(0, 199), 80);
+
+    // Splitting outside of the key range leaves one side empty.
+    auto empty = upper.SplitAt(1000);
+    EXPECT_EQ(empty.root(), nullptr);
+
+    t.Join(middle);
+    t.Join(upper);
+    EXPECT_EQ(middle.root(), nullptr);
+    EXPECT_EQ(upper.root(), nullptr);
+    for (int i = 0; i < 200; i++) {
+        auto found = t.Find(i);
+        ASSERT_NE(nullptr, found);
+        EXPECT_EQ(found->value(), i * 2);
+        EXPECT_EQ(t.Rank(i), i);
+    }
+
+    std::vector<BTree::Item<int, int>*> items;
+    ItemTester tester(&items);
+    t.root()->Traverse(tester);
+    EXPECT_EQ(items.size(), 200);
+    EXPECT_TRUE(tester.areSorted());
+}
+
+TEST(FTest, MoveAndClear) {
+    BTree::Tree<int, int> t;
+    BTree::Tree<int, int> other;
+    t.EnableBloomFilter();
+    for (int i = 0; i < 1000; i++) {
+        t.Insert(i, i);
+        other.Insert(i + 5000, i);
+    }
+    // Assigning drops what was there and the filter along with it.
+    t = std::move(other);
+    EXPECT_EQ(other.root(), nullptr);
+    EXPECT_EQ(t.bloom_filter(), nullptr);
+    EXPECT_EQ(t.Find(10), nullptr);
+    ASSERT_NE(t.Find(5010), nullptr);
+    EXPECT_EQ(t.Find(5010)->value(), 10);
+
+    t.EnableBloomFilter();
+    t.Clear();
+    EXPECT_EQ(t.root(), nullptr);
+    EXPECT_EQ(t.Find(5010), nullptr);
+    t.Insert(1, 2);
+    ASSERT_NE(t.Find(1), nullptr);
+    EXPECT_NE(t.bloom_filter(), nullptr);
+}
+
+TEST(FTest, FingerSearch) {
+    BTree::Tree<int, int> t;
+    std::vector<int> keys;
+    // Mostly increasing keys that now and then step back a little.
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back(i * 4 - (i % 7) * 5);
+    }
+    for (auto key : keys) {
+        t.InsertNear(key, key + 1);
+    }
+    for (auto key : keys) {
+        auto found = t.FindNear(key);
+        ASSERT_NE(nullptr, found);
+        EXPECT_EQ(found->value(), key + 1);
+        EXPECT_EQ(t.FindNear(key + 10000), nullptr);
+    }
+
+    // Deleting moves the finger, searches from there still work.
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        t.Delete(keys[i]);
+        t.InsertNear(keys[i] + 5000, keys[i]);
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto found = t.FindNear(keys[i]);
+        EXPECT_EQ(found == nullptr, i % 2 == 0);
+        EXPECT_NE(nullptr, t.Find(keys[i] + (i % 2 == 0 ? 5000 : 0)));
+    }
+
+    std::vector<BTree::Item<int, int>*> items;
+    ItemTester tester(&items);
+    t.root()->Traverse(tester);
+    EXPECT_EQ(items.size(), keys.size());
+    EXPECT_TRUE(tester.areSorted());
+
+    // Keys past either end of the tree are covered by the leaf at that end,
+    // the climb does not go up the spine to the root.
+    using Node = BTree::Node<int, int>;
+    Node* leftmost = t.root();
+    Node* rightmost = t.root();
+    while (!leftmost->IsLeaf()) {
+        leftmost = leftmost->FirstItem()->left();
+        rightmost = rightmost->LastItem()->right();
+    }
+    ASSERT_NE(leftmost, t.root());
+    EXPECT_EQ(rightmost->Climb(items.back()->key() + 1), rightmost);
+    EXPECT_EQ(leftmost->Climb(items.front()->key() - 1), leftmost);
+    // From one end to the other it does.
+    EXPECT_EQ(rightmost->Climb(items.front()->key() - 1), t.root());
+    for (auto item : items) {
+        EXPECT_EQ(rightmost->Climb(item->key())->Locate(item->key())->Find(item->key()), item);
+    }
+}
+
+TEST(FTest, AppendFastPath) {
+    BTree::Tree<int, int> t;
+    using Node = BTree::Node<int, int>;
+    t.EnableOrderStatistics();
+    for (int i = 0; i < 3000; i++) {
+        t.Insert(i * 2, i);
+    }
+
+    std::vector<Node*> nodes;
+    NodeTester tester(&nodes);
+    BFS::Traverse(t.root(), tester);
+    // Appended nodes are left with two items instead of one.
+    EXPECT_LE(tester.count(), 1600);
+
+    // Keys in between go through the regular path.
+    for (int i = 0; i < 100; i++) {
+        t.Insert(i * 60 + 1, -1);
+        t.Insert(6000 + i, i);
+    }
+    for (int i = 0; i < 3000; i++) {
+        auto found = t.Find(i * 2);
+        ASSERT_NE(nullptr, found);
+        EXPECT_EQ(found->value(), i);
+    }
+    for (int i = 0; i < 100; i++) {
+        EXPECT_NE(nullptr, t.Find(i * 60 + 1));
+        EXPECT_NE(nullptr, t.Find(6000 + i));
+    }
+    EXPECT_EQ(t.Rank(6000), 3100);
+    EXPECT_EQ(t.Select(3199)->key(), 6099);
+
+    std::vector<BTree::Item<int, int>*> items;
+    ItemTester item_tester(&items);
+    t.root()->Traverse(item_tester);
+    EXPECT_EQ(items.size(), 3200);
+    EXPECT_TRUE(item_tester.areSorted());
+}
+
+TEST(FTest, ScanFromKey) {
+    BTree::Tree<int, int> t;
+    for (int i = 0; i < 500; i++) {
+        t.Insert((i * 7919) % 500 * 2, i);
+    }
+    for (int from = -1; from < 1002; from += 7) {
+        std::vector<int> seen;
+        t.Scan(from, [&seen](BTree::Item<int, int>* item) {
+            seen.push_back(item->key());
+            return seen.size() < 20;
+        });
+        int first = from <= 0 ? 0 : (from + 1) / 2 * 2;
+        size_t expected = first >= 1000 ? 0 : std::min(20, (1000 - first) / 2);
+        ASSERT_EQ(seen.size(), expected);
+        for (size_t i = 0; i < seen.size(); i++) {
+            EXPECT_EQ(seen[i], first + 2 * static_cast<int>(i));
+        }
+    }
+}
+
+TEST(FTest, BloomFilter) {
+    BTree::Tree<int, int> t;
+    for (int i = 0; i < 5000; i++) {
+        t.Insert(2 * i, i);
+    }
+    t.EnableBloomFilter();
+    // Keys inserted after enabling it, past the size it started with.
+    for (int i = 5000; i < 20000; i++) {
+        t.Insert(2 * i, i);
+    }
+    for (int i = 0; i < 20000; i++) {
+        ASSERT_NE(t.Find(2 * i), nullptr);
+        EXPECT_EQ(t.Find(2 * i + 1), nullptr);
+    }
+    auto stats = t.bloom_filter()->stats();
+    EXPECT_GT(stats.rebuilds, 0);
+    EXPECT_EQ(stats.negatives + stats.false_positives, 20000);
+    EXPECT_LT(stats.FalsePositiveRate(), 0.03);
+
+    // Deleted keys are gone even before the filter is rebuilt.
+    for (int i = 0; i < 15000; i++) {
+        t.Delete(2 * i);
+        EXPECT_EQ(t.Find(2 * i), nullptr);
+    }
+    EXPECT_GT(t.bloom_filter()->stats().rebuilds, stats.rebuilds);
+    EXPECT_LE(t.bloom_filter()->keys(), 10000);
+    for (int i = 15000; i < 20000; i++) {
+        ASSERT_NE(t.FindNear(2 * i), nullptr);
+    }
+
+    // Joined keys are added to the filter.
+    BTree::Tree<int, int> other;
+    for (int i = 0; i < 3000; i++) {
+        other.Insert(100000 + i, i);
+    }
+    t.Join(other);
+    for (int i = 0; i < 3000; i++) {
+        ASSERT_NE(t.Find(100000 + i), nullptr);
+    }
+    auto upper = t.SplitAt(100000);
+    EXPECT_EQ(t.Find(100000), nullptr);
+    t.Insert(100000, 0);
+    EXPECT_NE(t.Find(100000), nullptr);
+
+    // The filter moves along with the tree.
+    BTree::BloomFilter* filter = t.bloom_filter();
+    BTree::Tree<int, int> moved(std::move(t));
+    EXPECT_EQ(moved.bloom_filter(), filter);
+    EXPECT_EQ(t.bloom_filter(), nullptr);
+    EXPECT_EQ(t.root(), nullptr);
+    EXPECT_NE(moved.Find(100000), nullptr);
+}
+
+// Counts its calls, to tell which hash a structure uses.
+struct CountingHash {
+    static int calls;
+    std::size_t operator()(int key) const {
+        calls++;
+        return std::hash<int>()(key);
+    }
+};
+int CountingHash::calls = 0;
+
+TEST(FTest, HotCache) {
+    BTree::Tree<int, int> t;
+    t.EnableHotCache(256);
+    for (int i = 0; i < 2000; i++) {
+        t.Insert(i, i);
+    }
+    // Items keep their address while others are deleted around them.
+    std::vector<BTree::Item<int, int>*> items;
+    for (int i = 0; i < 2000; i += 10) {
+        items.push_back(t.Find(i));
+    }
+    std::mt19937 rng(3);
+    std::map<int, int> model;
+    for (int i = 0; i < 2000; i++) {
+        model[i] = i;
+    }
+    for (int i = 0; i < 20000; i++) {
+        int key = rng() % 4000;
+        if (rng() % 3 == 0) {
+            if (key % 10 != 0) {
+                t.Delete(key);
+                model.erase(key);
+            }
+        } else if (rng() % 2 == 0) {
+            if (model.count(key) == 0) {
+                t.Insert(key, -key);
+                model[key] = -key;
+            }
+        } else {
+            // Hot keys from the first hundred, the rest read once.
+            int hot = rng() % 4 == 0 ? key : key % 100;
+            auto found = t.Find(hot);
+            if (model.count(hot) == 0) {
+                ASSERT_EQ(found, nullptr);
+            } else {
+                ASSERT_NE(found, nullptr);
+                ASSERT_EQ(found->key(), hot);
+                ASSERT_EQ(found->value(), model[hot]);
+            }
+        }
+    }
+    for (std::size_t i = 0; i < items.size(); i++) {
+        EXPECT_EQ(items[i]->key(), 10 * static_cast<int>(i));
+        EXPECT_EQ(t.Find(10 * static_cast<int>(i)), items[i]);
+    }
+
+    // A scan of keys read once leaves the hot keys in the cache.
+    auto stats = t.hot_cache()->stats();
+    EXPECT_GT(stats.HitRate(), 0.3);
+    EXPECT_GT(stats.rejections, 0);
+    for (int i = 0; i < 2000; i++) {
+        t.Find(i);
+    }
+    auto before = t.hot_cache()->stats();
+    for (int i = 0; i < 100; i += 10) {
+        EXPECT_EQ(t.Find(i)->key(), i);
+    }
+    EXPECT_EQ(t.hot_cache()->stats().hits - before.hits, 10);
+
+    // Keys split off are no longer found here.
+    auto upper = t.SplitAt(50);
+    EXPECT_EQ(t.Find(60), nullptr);
+    EXPECT_NE(upper.Find(60), nullptr);
+
+    // The cache moves along with the tree, the cached items stay valid.
+    BTree::Tree<int, int> moved(std::move(t));
+    EXPECT_EQ(t.hot_cache(), nullptr);
+    EXPECT_EQ(moved.Find(10), items[1]);
+
+    // The cache and the filter each hash with the Hash they were given.
+    BTree::Tree<int, int> hashed;
+    hashed.EnableHotCache();
+    hashed.EnableBloomFilter<CountingHash>();
+    hashed.Insert(1, 1);
+    CountingHash::calls = 0;
+    EXPECT_NE(hashed.Find(1), nullptr);
+    EXPECT_EQ(CountingHash::calls, 1);
+}
+
+template<std::size_t... Is>
+void CheckStaticTree(BTree::IndexSequence<Is...>) {
+    // Keys 0, 2, 4, ..., every odd key and both ends are missing.
+    const BTree::StaticEntry<int, int> entries[] = {{2 * static_cast<int>(Is), static_cast<int>(Is)}...};
+    const int n = sizeof...(Is);
+    ASSERT_TRUE(BTree::IsSorted(entries));
+    BTree::StaticTree<int, int, sizeof...(Is)> tree(entries);
+    for (int key = -1; key <= 2 * n; key++) {
+        auto found = tree.Find(key);
+        if (key >= 0 && key < 2 * n && key % 2 == 0) {
+            ASSERT_NE(found, nullptr);
+            EXPECT_EQ(found->key(), key);
+            EXPECT_EQ(found->value(), key / 2);
+        } else {
+            ASSERT_EQ(found, nullptr);
+        }
+    }
+}
+
+TEST(FTest, StaticTree) {
+    constexpr auto table = BTree::MakeStaticTree<int, char>(
+        {{1, 'a'}, {3, 'b'}, {5, 'c'}, {8, 'd'}, {13, 'e'}, {21, 'f'}});
+    static_assert(table.size() == 6 && table.kDepth == 3, "three levels");
+    static_assert(table.Find(13)->value() == 'e', "found at compile time");
+    static_assert(table.Find(4) == nullptr && table.Find(22) == nullptr, "missing keys");
+    EXPECT_EQ(table.Find(1)->value(), 'a');
+    EXPECT_EQ(table.Find(0), nullptr);
+
+    constexpr BTree::StaticEntry<int, int> unsorted[] = {{1, 0}, {3, 0}, {2, 0}};
+    static_assert(!BTree::IsSorted(unsorted), "out of order");
+
+    // Every shape of the last level.
+    CheckStaticTree(BTree::MakeIndexSequence<1>::Type());
+    CheckStaticTree(BTree::MakeIndexSequence<2>::Type());
+    CheckStaticTree(BTree::MakeIndexSequence<3>::Type());
+    CheckStaticTree(BTree::MakeIndexSequence<7>::Type());
+    CheckStaticTree(BTree::MakeIndexSequence<8>::Type());
+    CheckStaticTree(BTree::MakeIndexSequence<100>::Type());
+    CheckStaticTree(BTree::MakeIndexSequence<1000>::Type());
+}
+
+TEST(FTest, MVCCRepeatableReads) {
+    BTree::MVCCTree<int, int> t;
+    for (int i = 0; i < 100; i++) {
+        t.Put(i, 0);
+    }
+    auto old_read = t.BeginRead();
+    for (int i = 0; i < 100; i++) {
+        t.Put(i, 1);
+    }
+    for (int i = 0; i < 100; i += 2) {
+        EXPECT_NE(t.Delete(i), 0);
+    }
+    EXPECT_EQ(t.Delete(0), 0);
+    t.Put(1000, 1);
+
+    auto new_read = t.BeginRead();
+    EXPECT_EQ(new_read.timestamp(), t.clock());
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NE(old_read.Find(i), nullptr);
+        EXPECT_EQ(*old_read.Find(i), 0);
+        if (i % 2 == 0) {
+            EXPECT_EQ(new_read.Find(i), nullptr);
+        } else {
+            EXPECT_EQ(*new_read.Find(i), 1);
+        }
+    }
+    EXPECT_EQ(old_read.Find(1000), nullptr);
+    EXPECT_EQ(*new_read.Find(1000), 1);
+
+    // The old transaction keeps its versions alive.
+    const int* kept = old_read.Find(1);
+    EXPECT_EQ(t.Collect(), 0);
+    EXPECT_EQ(*kept, 0);
+    {
+        auto done = std::move(old_read);
+    }
+    // The first versions of the odd keys, and the deleted keys with all
+    // three of their versions.
+    EXPECT_EQ(t.Collect(), 50 + 150);
+    auto stats = t.stats();
+    EXPECT_EQ(stats.removed_keys, 50);
+    EXPECT_EQ(stats.versions, 51);
+    EXPECT_EQ(*new_read.Find(1), 1);
+    EXPECT_EQ(new_read.Find(2), nullptr);
+
+    // A deleted key comes back with a new version.
+    t.Put(2, 2);
+    EXPECT_EQ(*t.BeginRead().Find(2), 2);
+}
+
+TEST(FTest, MVCCConcurrentReaders) {
+    BTree::MVCCTree<int, int> t;
+    const int keys = 500;
+    for (int i = 0; i < keys; i++) {
+        t.Put(i, 0);
+    }
+    t.StartCollector(std::chrono::milliseconds(1));
+    std::atomic<bool> done(false);
+    std::thread writer([&t, &done, keys]() {
+        // Round r sets every key to r, deletes a few and adds new ones.
+        for (int round = 1; round <= 200; round++) {
+            for (int i = 0; i < keys; i++) {
+                t.Put(i, round);
+            }
+            t.Delete(keys + round - 1);
+            t.Put(keys + round, round);
+        }
+        done = true;
+    });
+    std::vector<std::thread> readers;
+    std::atomic<int> errors(0);
+    for (int r = 0; r < 4; r++) {
+        readers.emplace_back([&t, &done, &errors, keys]() {
+            while (!done) {
+                // Whatever a transaction read first, it reads again.
+                auto read = t.BeginRead();
+                std::vector<int> first;
+                for (int i = 0; i < keys; i++) {
+                    const int* value = read.Find(i);
+                    first.push_back(value == nullptr ? -1 : *value);
+                }
+                std::this_thread::yield();
+                for (int i = 0; i < keys; i++) {
+                    const int* value = read.Find(i);
+                    if (value == nullptr || *value != first[i]) {
+                        errors++;
+                    }
+                }
+            }
+        });
+    }
+    writer.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    t.StopCollector();
+    EXPECT_EQ(errors, 0);
+    t.Collect();
+    // Only the last version of every live key is left.
+    EXPECT_EQ(t.stats().versions, keys + 1);
+    auto read = t.BeginRead();
+    EXPECT_EQ(*read.Find(keys - 1), 200);
+    EXPECT_EQ(*read.Find(keys + 200), 200);
+    EXPECT_EQ(read.Find(keys + 199), nullptr);
+}
+
+TEST(FTest, BufferedTree) {
+    // Small buffers, so that most writes meet a merge in progress.
+    BTree::BufferedTree<int, int> t(8, 32);
+    std::map<int, int> model;
+    std::mt19937 rng(6);
+    for (int i = 0; i < 20000; i++) {
+        int key = rng() % 2000;
+        switch (rng() % 8) {
+            case 0:
+            case 1:
+                t.Delete(key);
+                model.erase(key);
+                break;
+            case 2: {
+                // Up to 20 keys from key on.
+                std::vector<std::pair<int, int>> seen;
+                t.Scan(key, [&seen](const int& k, const int& v) {
+                    seen.push_back({k, v});
+                    return seen.size() < 20;
+                });
+                std::vector<std::pair<int, int>> expected;
+                for (auto it = model.lower_bound(key); it != model.end() && expected.size() < 20; ++it) {
+                    expected.push_back(*it);
+                }
+                ASSERT_EQ(seen, expected);
+                break;
+            }
+            case 3: {
+                int value;
+                bool found = t.Find(key, &value);
+                ASSERT_EQ(found, model.count(key) == 1);
+                if (found) {
+                    ASSERT_EQ(value, model[key]);
+                }
+                break;
+            }
+            default:
+                t.Put(key, i);
+                model[key] = i;
+        }
+    }
+    EXPECT_GT(t.merges(), 100);
+    EXPECT_LE(t.buffered(), 8 + 2 * 40);
+
+    // After a merge everything is in the tree, once per key.
+    t.Merge();
+    EXPECT_EQ(t.buffered(), 0);
+    std::vector<std::pair<int, int>> items;
+    t.tree().Scan(0, [&items](BTree::Item<int, int>* item) {
+        items.push_back({item->key(), item->value()});
+        return true;
+    });
+    std::vector<std::pair<int, int>> expected(model.begin(), model.end());
+    EXPECT_EQ(items, expected);
+}
+
+#ifdef BTREE_HAS_COROUTINES
+TEST(FTest, FindInterleaved) {
+    BTree::Tree<int, int> t;
+    std::mt19937 rng(8);
+    std::vector<int> keys;
+    for (int i = 0; i < 5000; i++) {
+        int key = rng() % 20000;
+        t.Insert(key, i);
+        keys.push_back(key);
+        keys.push_back(key + 1);
+    }
+    EXPECT_TRUE(BTree::FindInterleaved(t, {}, 8).empty());
+    for (std::size_t group : {1, 3, 16, 100000}) {
+        auto found = BTree::FindInterleaved(t, keys, group);
+        ASSERT_EQ(found.size(), keys.size());
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            ASSERT_EQ(found[i], t.Find(keys[i]));
+        }
+    }
+}
+#endif
+
 GTEST_API_ int main(int argc, char **argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
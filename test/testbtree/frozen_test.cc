@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <vector>
+
+#include "btree.h"
+#include "frozen.h"
+#include "gtest/gtest.h"
+
+TEST(FrozenTest, FindAndLowerBound) {
+    BTree::Tree<int, int> t;
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back((i * 7919) % 1000 * 3);
+        t.Insert(keys.back(), i);
+    }
+    auto frozen = t.Freeze();
+    EXPECT_EQ(frozen.size(), keys.size());
+
+    for (int i = 0; i < 1000; i++) {
+        auto value = frozen.Find(keys[i]);
+        ASSERT_NE(nullptr, value);
+        EXPECT_EQ(*value, i);
+        EXPECT_EQ(frozen.Find(keys[i] + 1), nullptr);
+    }
+
+    std::sort(keys.begin(), keys.end());
+    for (int key = -2; key < 3002; key++) {
+        auto expected = std::lower_bound(keys.begin(), keys.end(), key);
+        auto slot = frozen.LowerBound(key);
+        if (expected == keys.end()) {
+            EXPECT_EQ(slot, 0);
+        } else {
+            ASSERT_NE(slot, 0);
+            EXPECT_EQ(frozen.KeyAt(slot), *expected);
+        }
+    }
+}
+
+TEST(FrozenTest, EmptyAndSmallTrees) {
+    BTree::Tree<int, int> t;
+    auto empty = t.Freeze();
+    EXPECT_EQ(empty.size(), 0);
+    EXPECT_EQ(empty.LowerBound(5), 0);
+    EXPECT_EQ(empty.Find(5), nullptr);
+
+    for (int n = 1; n < 40; n++) {
+        t.Insert(n * 10, n);
+        auto frozen = t.Freeze();
+        for (int i = 1; i <= n; i++) {
+            ASSERT_NE(nullptr, frozen.Find(i * 10));
+            EXPECT_EQ(*frozen.Find(i * 10), i);
+            EXPECT_EQ(frozen.KeyAt(frozen.LowerBound(i * 10 - 5)), i * 10);
+        }
+        EXPECT_EQ(frozen.LowerBound(n * 10 + 1), 0);
+    }
+}
@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "extent.h"
+#include "gtest/gtest.h"
+
+TEST(ExtentTest, SequentialBlocksCoalesce) {
+    FS::ExtentTree extents;
+    for (FS::BlockNumber block = 0; block < 10000; block++) {
+        extents.Map(block, 500 + block, 1);
+    }
+    EXPECT_EQ(extents.size(), 1);
+
+    // Out of order writes still end up as one extent.
+    FS::ExtentTree reversed;
+    for (FS::BlockNumber block = 100; block > 0; block--) {
+        reversed.Map(block - 1, 1000 + block - 1, 1);
+    }
+    EXPECT_EQ(reversed.size(), 1);
+
+    FS::BlockNumber physical;
+    ASSERT_TRUE(extents.Lookup(1234, &physical));
+    EXPECT_EQ(physical, 1734);
+    EXPECT_FALSE(extents.Lookup(10000, &physical));
+}
+
+TEST(ExtentTest, HolesAndDiscontiguousBlocks) {
+    FS::ExtentTree extents;
+    extents.Map(0, 100, 10);
+    extents.Map(10, 300, 10);
+    extents.Map(30, 110, 5);
+    EXPECT_EQ(extents.size(), 3);
+
+    FS::BlockNumber physical;
+    ASSERT_TRUE(extents.Lookup(9, &physical));
+    EXPECT_EQ(physical, 109);
+    ASSERT_TRUE(extents.Lookup(10, &physical));
+    EXPECT_EQ(physical, 300);
+    EXPECT_FALSE(extents.Lookup(25, &physical));
+
+    // Filling the hole physically after the first extent doesn't merge,
+    // the logical ranges are not adjacent.
+    FS::Extent extent;
+    ASSERT_TRUE(extents.Find(31, &extent));
+    EXPECT_EQ(extent.logical, 30);
+    EXPECT_EQ(extent.length, 5);
+}
+
+TEST(ExtentTest, RemapAndUnmapSplitExtents) {
+    FS::ExtentTree extents;
+    extents.Map(0, 1000, 100);
+
+    // Overwriting the middle leaves the head and the tail in place.
+    extents.Map(40, 5000, 20);
+    auto all = extents.Extents();
+    ASSERT_EQ(all.size(), 3);
+    EXPECT_EQ(all[0].length, 40);
+    EXPECT_EQ(all[1].physical, 5000);
+    EXPECT_EQ(all[2].logical, 60);
+    EXPECT_EQ(all[2].physical, 1060);
+
+    // Putting the original blocks back merges everything again.
+    extents.Map(40, 1040, 20);
+    EXPECT_EQ(extents.size(), 1);
+
+    auto removed = extents.Unmap(90, 50);
+    ASSERT_EQ(removed.size(), 1);
+    EXPECT_EQ(removed[0].logical, 90);
+    EXPECT_EQ(removed[0].physical, 1090);
+    EXPECT_EQ(removed[0].length, 10);
+
+    removed = extents.Unmap(10, 20);
+    ASSERT_EQ(removed.size(), 1);
+    EXPECT_EQ(removed[0].physical, 1010);
+    all = extents.Extents();
+    ASSERT_EQ(all.size(), 2);
+    EXPECT_EQ(all[0].end(), 10);
+    EXPECT_EQ(all[1].logical, 30);
+    EXPECT_EQ(all[1].end(), 90);
+}
@@ -0,0 +1,235 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "file_system.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+std::string ImagePath(const std::string& name) {
+    return "/tmp/testfs_" + name + ".img";
+}
+
+std::vector<char> Pattern(std::size_t size, int seed) {
+    std::vector<char> data(size);
+    for (std::size_t i = 0; i < size; i++) {
+        data[i] = static_cast<char>((i * 131 + seed) % 251);
+    }
+    return data;
+}
+} // namespace
+
+TEST(FileSystemTest, WriteAndReadBack) {
+    auto image = ImagePath("roundtrip");
+    {
+        FS::FileSystem fs(image);
+        ASSERT_TRUE(fs.ok());
+        ASSERT_TRUE(fs.Mkdir("/data"));
+        EXPECT_EQ(fs.Open("/data/file"), -1);
+        int fd = fs.Open("/data/file", FS::FileSystem::kCreate);
+        ASSERT_GE(fd, 0);
+        EXPECT_EQ(fs.Open("/data"), -1);
+
+        auto data = Pattern(100000, 1);
+        EXPECT_EQ(fs.Pwrite(fd, data.data(), data.size(), 0), 100000);
+        // Unaligned overwrite across page boundaries.
+        auto patch = Pattern(5000, 7);
+        EXPECT_EQ(fs.Pwrite(fd, patch.data(), patch.size(), 3000), 5000);
+        std::copy(patch.begin(), patch.end(), data.begin() + 3000);
+        ASSERT_TRUE(fs.Fsync(fd));
+
+        std::vector<char> back(data.size());
+        EXPECT_EQ(fs.Pread(fd, back.data(), back.size(), 0), 100000);
+        EXPECT_EQ(back, data);
+        // Reads stop at the end of the file.
+        EXPECT_EQ(fs.Pread(fd, back.data(), 10, 99995), 5);
+        EXPECT_EQ(fs.Pread(fd, back.data(), 10, 200000), 0);
+
+        // Writing past the end leaves a hole that reads as zeros.
+        char byte = 'x';
+        EXPECT_EQ(fs.Pwrite(fd, &byte, 1, 1 << 20), 1);
+        std::vector<char> hole(4096, 'y');
+        EXPECT_EQ(fs.Pread(fd, hole.data(), hole.size(), 500000), 4096);
+        EXPECT_EQ(hole, std::vector<char>(4096, 0));
+        EXPECT_TRUE(fs.Close(fd));
+        EXPECT_FALSE(fs.Close(fd));
+    }
+    std::remove(image.c_str());
+}
+
+TEST(FileSystemTest, WriteBackCoalesces) {
+    auto image = ImagePath("coalesce");
+    {
+        FS::FileSystem fs(image);
+        int fd = fs.Open("/file", FS::FileSystem::kCreate);
+        ASSERT_GE(fd, 0);
+        auto page = Pattern(FS::FileSystem::kPageSize, 3);
+        // Pages written in reverse order still go out as one write.
+        for (int i = 127; i >= 0; i--) {
+            fs.Pwrite(fd, page.data(), page.size(), i * FS::FileSystem::kPageSize);
+        }
+        auto writes = fs.device_writes();
+        ASSERT_TRUE(fs.Fsync(fd));
+        EXPECT_EQ(fs.device_writes(), writes + 1);
+        EXPECT_EQ(fs.Extents(fd)->size(), 1);
+        EXPECT_EQ(fs.cache().dirty(), 0);
+
+        // Rewriting in place keeps the block map as it is.
+        fs.Pwrite(fd, page.data(), page.size(), 10 * FS::FileSystem::kPageSize);
+        fs.Pwrite(fd, page.data(), page.size(), 11 * FS::FileSystem::kPageSize);
+        ASSERT_TRUE(fs.Fsync(fd));
+        EXPECT_EQ(fs.device_writes(), writes + 2);
+        EXPECT_EQ(fs.Extents(fd)->size(), 1);
+    }
+    std::remove(image.c_str());
+}
+
+TEST(FileSystemTest, SequentialReadsReadAhead) {
+    auto image = ImagePath("readahead");
+    {
+        // Small cache, so that the file has to come from the image again.
+        FS::FileSystem fs(image, 64);
+        int fd = fs.Open("/file", FS::FileSystem::kCreate);
+        const std::size_t pages = 1024;
+        auto data = Pattern(pages * FS::FileSystem::kPageSize, 5);
+        ASSERT_EQ(fs.Pwrite(fd, data.data(), data.size(), 0), data.size());
+        ASSERT_TRUE(fs.Fsync(fd));
+        EXPECT_LE(fs.cache().size(), 64);
+
+        auto reads = fs.device_reads();
+        std::vector<char> back(data.size());
+        for (std::size_t i = 0; i < pages; i++) {
+            std::size_t offset = i * FS::FileSystem::kPageSize;
+            ASSERT_EQ(fs.Pread(fd, &back[offset], FS::FileSystem::kPageSize, offset),
+                      FS::FileSystem::kPageSize);
+        }
+        EXPECT_EQ(back, data);
+        EXPECT_LE(fs.device_reads() - reads, pages / FS::FileSystem::kMaxReadahead + 4);
+
+        // Random reads only fetch what they need.
+        std::mt19937 rng(1);
+        for (int i = 0; i < 200; i++) {
+            std::size_t offset = rng() % (data.size() - 100);
+            char buffer[100];
+            ASSERT_EQ(fs.Pread(fd, buffer, sizeof(buffer), offset), 100);
+            ASSERT_TRUE(std::equal(buffer, buffer + 100, data.begin() + offset));
+        }
+    }
+    std::remove(image.c_str());
+}
+
+TEST(FileSystemTest, EvictionKeepsData) {
+    auto image = ImagePath("eviction");
+    {
+        FS::FileSystem fs(image, 64);
+        int a = fs.Open("/a", FS::FileSystem::kCreate);
+        int b = fs.Open("/b", FS::FileSystem::kCreate);
+        std::mt19937 rng(2);
+        std::vector<char> model_a(300000), model_b(300000);
+        for (int i = 0; i < 2000; i++) {
+            int fd = i % 2 ? a : b;
+            auto& model = i % 2 ? model_a : model_b;
+            std::size_t size = 1 + rng() % 10000;
+            std::size_t offset = rng() % (model.size() - size);
+            auto chunk = Pattern(size, i);
+            ASSERT_EQ(fs.Pwrite(fd, chunk.data(), size, offset), size);
+            std::copy(chunk.begin(), chunk.end(), model.begin() + offset);
+        }
+        for (int fd : {a, b}) {
+            auto& model = fd == a ? model_a : model_b;
+            FS::Inode inode;
+            fs.metadata().GetInode(fs.metadata().Resolve(fd == a ? "/a" : "/b"), &inode);
+            std::vector<char> back(inode.size);
+            ASSERT_EQ(fs.Pread(fd, back.data(), back.size(), 0), inode.size);
+            EXPECT_TRUE(std::equal(back.begin(), back.end(), model.begin()));
+        }
+    }
+    std::remove(image.c_str());
+}
+
+TEST(FileSystemTest, ReadManyBatchesMisses) {
+    for (bool async_io : {true, false}) {
+        auto image = ImagePath("readmany");
+        {
+            FS::FileSystem fs(image, 256, async_io);
+            int fd = fs.Open("/file", FS::FileSystem::kCreate);
+            const std::size_t pages = 2048;
+            auto data = Pattern(pages * FS::FileSystem::kPageSize, 9);
+            // Scattered writes, so the file ends up in many extents.
+            for (std::size_t i = 0; i < pages; i += 2) {
+                fs.Pwrite(fd, &data[i * FS::FileSystem::kPageSize],
+                          FS::FileSystem::kPageSize, i * FS::FileSystem::kPageSize);
+            }
+            ASSERT_TRUE(fs.Fsync(fd));
+            for (std::size_t i = 1; i < pages; i += 2) {
+                fs.Pwrite(fd, &data[i * FS::FileSystem::kPageSize],
+                          FS::FileSystem::kPageSize, i * FS::FileSystem::kPageSize);
+            }
+            ASSERT_TRUE(fs.Fsync(fd));
+
+            std::mt19937 rng(3);
+            std::vector<std::vector<char>> buffers(300, std::vector<char>(6000));
+            std::vector<FS::FileSystem::ReadRequest> requests;
+            for (auto& buffer : buffers) {
+                std::uint64_t offset = rng() % data.size();
+                requests.push_back({buffer.data(), buffer.size(), offset, 0});
+            }
+            auto misses = fs.cache().misses();
+            ASSERT_TRUE(fs.ReadMany(fd, requests)) << fs.backend();
+            // Everything was read by the batches, the copies all hit.
+            EXPECT_EQ(fs.cache().misses(), misses);
+            for (const auto& request : requests) {
+                std::size_t expected = std::min<std::uint64_t>(request.count,
+                                                               data.size() - request.offset);
+                ASSERT_EQ(request.result, expected);
+                const char* buf = static_cast<const char*>(request.buf);
+                EXPECT_TRUE(std::equal(buf, buf + expected, data.begin() + request.offset));
+            }
+        }
+        std::remove(image.c_str());
+    }
+}
+
+TEST(FileSystemTest, UnlinkFreesBlocks) {
+    auto image = ImagePath("unlink");
+    {
+        FS::FileSystem fs(image);
+        auto data = Pattern(64 * FS::FileSystem::kPageSize, 11);
+        int a = fs.Open("/a", FS::FileSystem::kCreate);
+        int b = fs.Open("/b", FS::FileSystem::kCreate);
+        // Appending after a sync continues right after the blocks the file
+        // already has.
+        for (int half = 0; half < 2; half++) {
+            std::size_t offset = half * 32 * FS::FileSystem::kPageSize;
+            fs.Pwrite(a, &data[offset], 32 * FS::FileSystem::kPageSize, offset);
+            ASSERT_TRUE(fs.Fsync(a));
+            fs.Pwrite(b, &data[offset], 32 * FS::FileSystem::kPageSize, offset);
+        }
+        ASSERT_TRUE(fs.Fsync(b));
+        EXPECT_EQ(fs.Extents(a)->size(), 1);
+        EXPECT_EQ(fs.Extents(b)->size(), 1);
+
+        auto free_blocks = fs.free_space().free_blocks();
+        EXPECT_TRUE(fs.Unlink("/a"));
+        EXPECT_FALSE(fs.Unlink("/a"));
+        EXPECT_EQ(fs.free_space().free_blocks(), free_blocks + 64);
+        EXPECT_EQ(fs.Pread(a, data.data(), 1, 0), -1);
+
+        // Growing past the initial size works and the freed blocks are
+        // used again.
+        int c = fs.Open("/c", FS::FileSystem::kCreate);
+        std::vector<char> big(4 * FS::FileSystem::kInitialBlocks * FS::FileSystem::kPageSize, 'c');
+        ASSERT_EQ(fs.Pwrite(c, big.data(), big.size(), 0), big.size());
+        ASSERT_TRUE(fs.Sync());
+        EXPECT_GT(fs.free_space().total(), 4 * FS::FileSystem::kInitialBlocks);
+        std::vector<char> back(big.size());
+        ASSERT_EQ(fs.Pread(c, back.data(), back.size(), 0), back.size());
+        EXPECT_EQ(back, big);
+    }
+    std::remove(image.c_str());
+}
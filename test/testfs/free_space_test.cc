@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "free_space.h"
+#include "gtest/gtest.h"
+
+TEST(FreeSpaceTest, FreeCoalesces) {
+    FS::FreeSpaceManager space(1000);
+    std::vector<FS::BlockNumber> starts;
+    for (int i = 0; i < 10; i++) {
+        FS::BlockNumber start;
+        ASSERT_TRUE(space.Allocate(100, &start));
+        starts.push_back(start);
+    }
+    EXPECT_EQ(space.free_blocks(), 0);
+    FS::BlockNumber start;
+    EXPECT_FALSE(space.Allocate(1, &start));
+
+    // Every other one, then the rest, which joins them all again.
+    for (int i = 0; i < 10; i += 2) {
+        EXPECT_TRUE(space.Free(starts[i], 100));
+    }
+    EXPECT_EQ(space.FreeExtents().size(), 5);
+    EXPECT_FALSE(space.Free(starts[0], 100));
+    EXPECT_FALSE(space.Free(starts[0] + 50, 100));
+    for (int i = 1; i < 10; i += 2) {
+        EXPECT_TRUE(space.Free(starts[i], 100));
+    }
+    auto extents = space.FreeExtents();
+    ASSERT_EQ(extents.size(), 1);
+    EXPECT_EQ(extents[0], std::make_pair(FS::BlockNumber(0), FS::BlockNumber(1000)));
+    EXPECT_EQ(space.free_blocks(), 1000);
+}
+
+TEST(FreeSpaceTest, BestFitAndGoal) {
+    FS::FreeSpaceManager space(100);
+    FS::BlockNumber start;
+    ASSERT_TRUE(space.Allocate(100, &start));
+    // Holes of 5, 3 and 8 blocks.
+    space.Free(10, 5);
+    space.Free(30, 3);
+    space.Free(50, 8);
+
+    ASSERT_TRUE(space.Allocate(3, &start));
+    EXPECT_EQ(start, 30);
+    ASSERT_TRUE(space.Allocate(4, &start));
+    EXPECT_EQ(start, 10);
+    EXPECT_FALSE(space.Allocate(9, &start));
+    // Goal inside a free extent is honoured, outside of one ignored.
+    ASSERT_TRUE(space.Allocate(2, &start, 53));
+    EXPECT_EQ(start, 53);
+    ASSERT_TRUE(space.Allocate(1, &start, 0));
+    EXPECT_EQ(start, 14);
+
+    space.Grow(50);
+    EXPECT_EQ(space.total(), 150);
+    ASSERT_TRUE(space.Allocate(50, &start));
+    EXPECT_EQ(start, 100);
+}
+
+TEST(FreeSpaceTest, FindFreeSkipsFullWords) {
+    const FS::BlockNumber total = 1 << 20;
+    FS::FreeSpaceManager space(total);
+    FS::BlockNumber start;
+    ASSERT_TRUE(space.Allocate(total, &start));
+    EXPECT_EQ(space.FindFree(0), total);
+    space.Free(700000, 1);
+    space.Free(total - 1, 1);
+    EXPECT_EQ(space.FindFree(0), 700000);
+    EXPECT_EQ(space.FindFree(700001), total - 1);
+    EXPECT_TRUE(space.IsFree(700000));
+    EXPECT_FALSE(space.IsFree(700001));
+
+    // Single blocks are taken lowest first.
+    ASSERT_TRUE(space.Allocate(1, &start));
+    EXPECT_EQ(start, 700000);
+}
+
+TEST(FreeSpaceTest, RandomAgainstModel) {
+    const FS::BlockNumber total = 5000;
+    FS::FreeSpaceManager space(total);
+    std::vector<bool> used(total);
+    std::vector<std::pair<FS::BlockNumber, FS::BlockNumber>> allocated;
+    std::mt19937 rng(4);
+    for (int i = 0; i < 20000; i++) {
+        if (allocated.empty() || rng() % 3 != 0) {
+            FS::BlockNumber count = 1 + rng() % 40;
+            FS::BlockNumber goal = rng() % 2 ? rng() % total : FS::FreeSpaceManager::kNoGoal;
+            FS::BlockNumber start;
+            if (space.Allocate(count, &start, goal)) {
+                for (FS::BlockNumber b = start; b < start + count; b++) {
+                    ASSERT_FALSE(used[b]);
+                    used[b] = true;
+                }
+                allocated.push_back({start, count});
+            }
+        } else {
+            std::size_t victim = rng() % allocated.size();
+            auto extent = allocated[victim];
+            allocated[victim] = allocated.back();
+            allocated.pop_back();
+            ASSERT_TRUE(space.Free(extent.first, extent.second));
+            for (FS::BlockNumber b = extent.first; b < extent.first + extent.second; b++) {
+                used[b] = false;
+            }
+        }
+    }
+    // Free extents are maximal and match the model block for block.
+    FS::BlockNumber free_blocks = 0;
+    FS::BlockNumber previous_end = total + 1;
+    for (const auto& extent : space.FreeExtents()) {
+        EXPECT_NE(extent.first, previous_end);
+        for (FS::BlockNumber b = extent.first; b < extent.first + extent.second; b++) {
+            ASSERT_FALSE(used[b]);
+        }
+        free_blocks += extent.second;
+        previous_end = extent.first + extent.second;
+    }
+    EXPECT_EQ(free_blocks, std::count(used.begin(), used.end(), false));
+    EXPECT_EQ(space.free_blocks(), free_blocks);
+    for (FS::BlockNumber b = 0; b < total; b++) {
+        ASSERT_EQ(space.IsFree(b), !used[b]);
+    }
+}
+
+TEST(FreeSpaceTest, SaveAndLoad) {
+    const char* path = "/tmp/testfs_free_space.img";
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    FS::FreeSpaceManager space(100000);
+    FS::BlockNumber start;
+    for (int i = 0; i < 100; i++) {
+        space.Allocate(1 + i % 7, &start);
+    }
+    space.Free(20, 30);
+    ASSERT_TRUE(space.Save(fd, 8192));
+
+    FS::FreeSpaceManager loaded;
+    EXPECT_FALSE(loaded.Load(fd, 0));
+    ASSERT_TRUE(loaded.Load(fd, 8192));
+    EXPECT_EQ(loaded.total(), space.total());
+    EXPECT_EQ(loaded.free_blocks(), space.free_blocks());
+    EXPECT_EQ(loaded.FreeExtents(), space.FreeExtents());
+    EXPECT_EQ(loaded.FindFree(0), 20);
+    ASSERT_TRUE(loaded.Allocate(30, &start));
+    EXPECT_EQ(start, 20);
+
+    // A damaged record is refused.
+    char byte = 0x55;
+    ::pwrite(fd, &byte, 1, 8192 + 100);
+    FS::FreeSpaceManager damaged;
+    EXPECT_FALSE(damaged.Load(fd, 8192));
+
+    // So is a header whose sizes go past the end of the file.
+    std::uint64_t header[4] = {0x3143505345455246, std::uint64_t(1) << 62, 1, 0};
+    ASSERT_EQ(::pwrite(fd, header, sizeof(header), 8192), sizeof(header));
+    EXPECT_FALSE(damaged.Load(fd, 8192));
+    header[1] = 6400;
+    header[2] = 5000;
+    ASSERT_EQ(::pwrite(fd, header, sizeof(header), 8192), sizeof(header));
+    EXPECT_FALSE(damaged.Load(fd, 8192));
+    EXPECT_EQ(damaged.total(), 0);
+    ::close(fd);
+    std::remove(path);
+}
@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "io_backend.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// The sync backend, and the io_uring one where the kernel allows it.
+std::vector<std::unique_ptr<FS::IOBackend>> Backends(int fd, unsigned depth) {
+    std::vector<std::unique_ptr<FS::IOBackend>> backends;
+    backends.emplace_back(new FS::SyncBackend(fd));
+    auto uring = FS::UringBackend::Create(fd, depth);
+    if (uring != nullptr) {
+        backends.push_back(std::move(uring));
+    }
+    return backends;
+}
+
+FS::IORequest Request(FS::IORequest::Op op, std::vector<char>& buffer,
+                      std::uint64_t offset) {
+    FS::IORequest request;
+    request.op = op;
+    request.offset = offset;
+    request.iov.push_back({buffer.data(), buffer.size()});
+    return request;
+}
+} // namespace
+
+TEST(IOBackendTest, BatchesLargerThanTheQueue) {
+    const char* path = "/tmp/testfs_backend.img";
+    int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    for (auto& backend : Backends(fd, 4)) {
+        const int n = 100;
+        std::vector<std::vector<char>> blocks;
+        std::vector<FS::IORequest> writes;
+        for (int i = 0; i < n; i++) {
+            blocks.emplace_back(4096, static_cast<char>(i));
+        }
+        for (int i = 0; i < n; i++) {
+            writes.push_back(Request(FS::IORequest::Op::kWrite, blocks[i], i * 4096));
+        }
+        ASSERT_TRUE(backend->WriteAndSync(writes)) << backend->name();
+        for (const auto& write : writes) {
+            EXPECT_EQ(write.result, 4096);
+        }
+
+        // Read them back in reverse, one past the end comes back empty.
+        std::vector<std::vector<char>> back(n + 1, std::vector<char>(4096));
+        std::vector<FS::IORequest> reads;
+        for (int i = n; i >= 0; i--) {
+            reads.push_back(Request(FS::IORequest::Op::kRead, back[i], i * 4096));
+        }
+        ASSERT_TRUE(backend->Submit(reads)) << backend->name();
+        EXPECT_EQ(reads[0].result, 0);
+        for (int i = 0; i < n; i++) {
+            EXPECT_EQ(back[i], blocks[i]) << backend->name();
+        }
+    }
+    ::close(fd);
+    std::remove(path);
+}
+
+TEST(IOBackendTest, FailuresAreReported) {
+    const char* path = "/tmp/testfs_backend_ro.img";
+    int fd = ::open(path, O_RDONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_GE(fd, 0);
+    for (auto& backend : Backends(fd, 8)) {
+        std::vector<char> block(4096, 'x');
+        std::vector<FS::IORequest> writes;
+        for (int i = 0; i < 3; i++) {
+            writes.push_back(Request(FS::IORequest::Op::kWrite, block, i * 4096));
+        }
+        EXPECT_FALSE(backend->WriteAndSync(writes)) << backend->name();
+        EXPECT_LT(writes[0].result, 0);
+        EXPECT_FALSE(backend->Submit(writes)) << backend->name();
+    }
+    ::close(fd);
+    std::remove(path);
+}
@@ -0,0 +1,109 @@
+#include <string>
+#include <vector>
+
+#include "metadata.h"
+#include "gtest/gtest.h"
+
+TEST(MetadataTest, CreateLookupAndResolve) {
+    FS::MetadataStore store;
+    auto docs = store.Create(FS::kRootInode, "docs", FS::FileType::kDirectory);
+    auto notes = store.Create(docs, "notes.txt", FS::FileType::kFile);
+    ASSERT_NE(docs, FS::kNoInode);
+    ASSERT_NE(notes, FS::kNoInode);
+
+    EXPECT_EQ(store.Lookup(FS::kRootInode, "docs"), docs);
+    EXPECT_EQ(store.Resolve("/docs/notes.txt"), notes);
+    EXPECT_EQ(store.Resolve("/docs//notes.txt"), notes);
+    EXPECT_EQ(store.Resolve("/"), FS::kRootInode);
+    EXPECT_EQ(store.Resolve("/docs/missing"), FS::kNoInode);
+    EXPECT_EQ(store.Resolve("/docs/notes.txt/below"), FS::kNoInode);
+
+    // Names are unique per directory and files cannot hold entries.
+    EXPECT_EQ(store.Create(docs, "notes.txt", FS::FileType::kFile), FS::kNoInode);
+    EXPECT_EQ(store.Create(notes, "x", FS::FileType::kFile), FS::kNoInode);
+
+    FS::Inode inode;
+    ASSERT_TRUE(store.GetInode(notes, &inode));
+    EXPECT_EQ(inode.type, FS::FileType::kFile);
+    EXPECT_TRUE(store.SetSize(notes, 42));
+    ASSERT_TRUE(store.GetInode(notes, &inode));
+    EXPECT_EQ(inode.size, 42);
+
+    // Second resolution of the same path is served from the cache.
+    auto hits = store.cache_hits();
+    store.Resolve("/docs/notes.txt");
+    EXPECT_EQ(store.cache_hits(), hits + 2);
+}
+
+TEST(MetadataTest, ListLargeDirectory) {
+    FS::MetadataStore store;
+    auto a = store.Create(FS::kRootInode, "a", FS::FileType::kDirectory);
+    auto b = store.Create(FS::kRootInode, "b", FS::FileType::kDirectory);
+    auto c = store.Create(FS::kRootInode, "c", FS::FileType::kDirectory);
+    for (int i = 0; i < 5000; i++) {
+        store.Create(b, "file" + std::to_string(i), FS::FileType::kFile);
+    }
+    store.Create(a, "only", FS::FileType::kFile);
+
+    auto listing = store.List(b);
+    ASSERT_EQ(listing.size(), 5000);
+    for (size_t i = 1; i < listing.size(); i++) {
+        EXPECT_LT(listing[i - 1].name, listing[i].name);
+    }
+    EXPECT_EQ(store.List(a).size(), 1);
+    EXPECT_EQ(store.List(c).size(), 0);
+    EXPECT_EQ(store.List(FS::kRootInode).size(), 3);
+
+    int visited = 0;
+    store.ForEachEntry(b, [&visited](const FS::DirEntry&) {
+        return ++visited < 10;
+    });
+    EXPECT_EQ(visited, 10);
+}
+
+TEST(MetadataTest, UnlinkAndRename) {
+    FS::MetadataStore store;
+    auto dir = store.Create(FS::kRootInode, "dir", FS::FileType::kDirectory);
+    auto file = store.Create(dir, "file", FS::FileType::kFile);
+    EXPECT_EQ(store.Resolve("/dir/file"), file);
+
+    // Directories have to be empty before they go.
+    EXPECT_FALSE(store.Unlink(FS::kRootInode, "dir"));
+    EXPECT_TRUE(store.Rename(dir, "file", FS::kRootInode, "moved"));
+    EXPECT_EQ(store.Resolve("/dir/file"), FS::kNoInode);
+    EXPECT_EQ(store.Resolve("/moved"), file);
+    EXPECT_FALSE(store.Rename(FS::kRootInode, "moved", FS::kRootInode, "dir"));
+
+    EXPECT_TRUE(store.Unlink(FS::kRootInode, "dir"));
+    EXPECT_TRUE(store.Unlink(FS::kRootInode, "moved"));
+    EXPECT_FALSE(store.Unlink(FS::kRootInode, "moved"));
+    FS::Inode inode;
+    EXPECT_FALSE(store.GetInode(file, &inode));
+    EXPECT_EQ(store.List(FS::kRootInode).size(), 0);
+}
+
+TEST(MetadataTest, RenameDirectoryBelowItself) {
+    FS::MetadataStore store;
+    auto a = store.Create(FS::kRootInode, "a", FS::FileType::kDirectory);
+    auto b = store.Create(a, "b", FS::FileType::kDirectory);
+    auto c = store.Create(b, "c", FS::FileType::kDirectory);
+
+    EXPECT_FALSE(store.Rename(FS::kRootInode, "a", a, "a2"));
+    EXPECT_FALSE(store.Rename(FS::kRootInode, "a", b, "a2"));
+    EXPECT_FALSE(store.Rename(FS::kRootInode, "a", c, "a2"));
+    EXPECT_FALSE(store.Rename(a, "b", c, "b2"));
+    EXPECT_EQ(store.Resolve("/a/b/c"), c);
+    EXPECT_EQ(store.List(FS::kRootInode).size(), 1);
+
+    // Moving c up and then b below it is fine.
+    EXPECT_TRUE(store.Rename(b, "c", FS::kRootInode, "c"));
+    EXPECT_TRUE(store.Rename(a, "b", c, "b"));
+    EXPECT_EQ(store.Resolve("/c/b"), b);
+    EXPECT_FALSE(store.Rename(FS::kRootInode, "c", b, "c"));
+    EXPECT_EQ(store.Resolve("/c"), c);
+}
+
+GTEST_API_ int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}